@@ -14,27 +14,28 @@
 #include "Helios.h"
 
 // static members of Button
-uint32_t Button::m_pressTime = 0;
-uint32_t Button::m_releaseTime = 0;
-uint32_t Button::m_holdDuration = 0;
-uint32_t Button::m_releaseDuration = 0;
-uint8_t Button::m_releaseCount = 0;
-bool Button::m_buttonState = false;
-bool Button::m_newPress = false;
-bool Button::m_newRelease = false;
-bool Button::m_isPressed = false;
-bool Button::m_shortClick = false;
-bool Button::m_longClick = false;
-bool Button::m_holdClick = false;
+HELIOS_TLS uint32_t Button::m_pressTime = 0;
+HELIOS_TLS uint32_t Button::m_releaseTime = 0;
+HELIOS_TLS uint32_t Button::m_holdDuration = 0;
+HELIOS_TLS uint32_t Button::m_releaseDuration = 0;
+HELIOS_TLS uint8_t Button::m_releaseCount = 0;
+HELIOS_TLS bool Button::m_buttonState = false;
+HELIOS_TLS bool Button::m_newPress = false;
+HELIOS_TLS bool Button::m_newRelease = false;
+HELIOS_TLS bool Button::m_isPressed = false;
+HELIOS_TLS bool Button::m_shortClick = false;
+HELIOS_TLS bool Button::m_longClick = false;
+HELIOS_TLS bool Button::m_holdClick = false;
 
 #ifdef HELIOS_CLI
 // an input queue for the button, each tick one even is processed
 // out of this queue and used to produce input
-std::queue<char> Button::m_inputQueue;
+HELIOS_TLS std::deque<Button::InputRun> Button::m_inputQueue;
+HELIOS_TLS uint32_t Button::m_numInputs = 0;
 // the virtual pin state
-bool Button::m_pinState = false;
+HELIOS_TLS bool Button::m_pinState = false;
 // whether the button is waiting to wake the device
-bool Button::m_enableWake = false;
+HELIOS_TLS bool Button::m_enableWake = false;
 #endif
 
 // initialize a new button object with a pin number
@@ -168,7 +169,7 @@ bool Button::processPreInput()
   if (!m_inputQueue.size()) {
     return false;
   }
-  char command = m_inputQueue.front();
+  char command = m_inputQueue.front().command;
   switch (command) {
   case 'p': // press
     Button::doPress();
@@ -191,7 +192,7 @@ bool Button::processPreInput()
     return false;
   }
   // now pop whatever pre-input command was processed
-  m_inputQueue.pop();
+  popInput();
   return true;
 }
 
@@ -202,7 +203,7 @@ bool Button::processPostInput()
     return false;
   }
   // process input queue from the command line
-  char command = m_inputQueue.front();
+  char command = m_inputQueue.front().command;
   switch (command) {
   case 'c': // click button
     Button::doShortClick();
@@ -214,10 +215,18 @@ bool Button::processPostInput()
     // should never happen
     return false;
   }
-  m_inputQueue.pop();
+  popInput();
   return true;
 }
 
+void Button::popInput()
+{
+  m_numInputs--;
+  if (!--m_inputQueue.front().count) {
+    m_inputQueue.pop_front();
+  }
+}
+
 void Button::doShortClick()
 {
   m_newRelease = true;
@@ -263,14 +272,69 @@ void Button::doToggle()
 }
 
 // queue up an input event for the button
-void Button::queueInput(char input)
+void Button::queueInput(char input, uint32_t count)
 {
-  m_inputQueue.push(input);
+  if (!count) {
+    return;
+  }
+  m_numInputs += count;
+  // the same input again just makes the last run longer
+  if (!m_inputQueue.empty() && m_inputQueue.back().command == input) {
+    m_inputQueue.back().count += count;
+    return;
+  }
+  m_inputQueue.push_back({input, count});
 }
 
 uint32_t Button::inputQueueSize()
 {
-  return m_inputQueue.size();
+  return m_numInputs;
+}
+
+char Button::nextInput()
+{
+  return m_inputQueue.empty() ? 0 : m_inputQueue.front().command;
+}
+
+uint32_t Button::nextEventTick(uint32_t limit)
+{
+  if (m_inputQueue.empty()) {
+    return limit;
+  }
+  // each wait holds off the next input by one tick, the waits in a row are
+  // all in the first run because runs of the same command are merged
+  uint32_t now = Time::getCurtime();
+  uint32_t numWaits = 0;
+  if (m_inputQueue.front().command == 'w') {
+    numWaits = m_inputQueue.front().count;
+  }
+  if (numWaits > 0 && (uint64_t)now + numWaits - 1 >= limit) {
+    return limit;
+  }
+  return now + numWaits;
+}
+
+void Button::skipTicks(uint32_t numTicks)
+{
+  if (!numTicks) {
+    return;
+  }
+  if (!m_inputQueue.empty() && m_inputQueue.front().command == 'w') {
+    InputRun &waits = m_inputQueue.front();
+    uint32_t numWaits = (numTicks < waits.count) ? numTicks : waits.count;
+    m_numInputs -= numWaits;
+    waits.count -= numWaits;
+    if (!waits.count) {
+      m_inputQueue.pop_front();
+    }
+  }
+  // the durations are left as the last skipped tick would have set them
+  uint32_t lastTick = Time::getCurtime() + numTicks - 1;
+  if (m_isPressed) {
+    m_holdDuration = (lastTick >= m_pressTime) ? (uint32_t)(lastTick - m_pressTime) : 0;
+  } else {
+    m_releaseDuration = (lastTick >= m_releaseTime) ? (uint32_t)(lastTick - m_releaseTime) : 0;
+  }
 }
 #endif
 
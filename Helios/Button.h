@@ -1,7 +1,12 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
 #include <stdint.h>
 
+#include "HeliosConfig.h"
+
 #ifdef HELIOS_CLI
-#include <queue>
+#include <deque>
 #endif
 
 class Button
@@ -65,9 +70,28 @@ public:
   static void doRelease();
   static void doToggle();
 
-  // queue up an input event for the button
-  static void queueInput(char input);
+  // a command and the number of times in a row it was queued
+  struct InputRun
+  {
+    char command;
+    uint32_t count;
+  };
+
+  // queue up an input event for the button, or a number of the same event in
+  // a row, repeats only take up a single run in the queue no matter how many
+  static void queueInput(char input, uint32_t count = 1);
+  // the number of input events left, counting every repeat
   static uint32_t inputQueueSize();
+  // the input that will be processed next, or 0 if the queue is empty
+  static char nextInput();
+
+  // the tick that the next queued input is processed, a run of waits at the
+  // front of the queue pushes this out, the search stops at the limit tick
+  static uint32_t nextEventTick(uint32_t limit = UINT32_MAX);
+  // fast forward over ticks without updating, this consumes the waits and
+  // catches up the hold and release durations as if each tick had run, it
+  // is only valid for ticks before nextEventTick()
+  static void skipTicks(uint32_t numTicks);
 #endif
 
 private:
@@ -75,45 +99,54 @@ private:
   // state data that is populated each check
 
   // the timestamp of when the button was pressed
-  static uint32_t m_pressTime;
+  static HELIOS_TLS uint32_t m_pressTime;
   // the timestamp of when the button was released
-  static uint32_t m_releaseTime;
+  static HELIOS_TLS uint32_t m_releaseTime;
 
   // the last hold duration
-  static uint32_t m_holdDuration;
+  static HELIOS_TLS uint32_t m_holdDuration;
   // the last release duration
-  static uint32_t m_releaseDuration;
+  static HELIOS_TLS uint32_t m_releaseDuration;
 
   // the number of times released, will overflow at 255
-  static uint8_t m_releaseCount;
+  static HELIOS_TLS uint8_t m_releaseCount;
 
   // the active state of the button
-  static bool m_buttonState;
+  static HELIOS_TLS bool m_buttonState;
 
   // whether pressed this tick
-  static bool m_newPress;
+  static HELIOS_TLS bool m_newPress;
   // whether released this tick
-  static bool m_newRelease;
+  static HELIOS_TLS bool m_newRelease;
   // whether currently pressed
-  static bool m_isPressed;
+  static HELIOS_TLS bool m_isPressed;
   // whether a short click occurred
-  static bool m_shortClick;
+  static HELIOS_TLS bool m_shortClick;
   // whether a long click occurred
-  static bool m_longClick;
+  static HELIOS_TLS bool m_longClick;
   // whether a long hold occurred
-  static bool m_holdClick;
+  static HELIOS_TLS bool m_holdClick;
 
 #ifdef HELIOS_CLI
+  // the engine context swaps these globals in and out for each device
+  friend class HeliosEngine;
+
   // process pre or post input events from the queue
   static bool processPreInput();
   static bool processPostInput();
+  // remove the input event at the front of the queue
+  static void popInput();
 
   // an input queue for the button, each tick one even is processed
   // out of this queue and used to produce input
-  static std::queue<char> m_inputQueue;
+  static HELIOS_TLS std::deque<InputRun> m_inputQueue;
+  // the total count of all the runs in the queue
+  static HELIOS_TLS uint32_t m_numInputs;
   // the virtual pin state that is polled instead of a digital pin
-  static bool m_pinState;
+  static HELIOS_TLS bool m_pinState;
   // whether the button is waiting to wake the device
-  static bool m_enableWake;
+  static HELIOS_TLS bool m_enableWake;
 #endif
 };
+
+#endif
@@ -2,7 +2,7 @@
 
 #if ALTERNATIVE_HSV_RGB == 1
 // global hsv to rgb algorithm selector
-hsv_to_rgb_algorithm g_hsv_rgb_alg = HSV_TO_RGB_GENERIC;
+HELIOS_TLS hsv_to_rgb_algorithm g_hsv_rgb_alg = HSV_TO_RGB_GENERIC;
 #endif
 
 HSVColor::HSVColor() :
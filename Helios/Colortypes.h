@@ -15,7 +15,7 @@ enum hsv_to_rgb_algorithm : uint8_t
 
 // global hsv to rgb algorithm selector, switch this to control
 // all hsv to rgb conversions
-extern hsv_to_rgb_algorithm g_hsv_rgb_alg;
+extern HELIOS_TLS hsv_to_rgb_algorithm g_hsv_rgb_alg;
 #endif
 
 class ByteStream;
@@ -28,20 +28,20 @@
 // the number of menus in quadrant selection
 #define NUM_MENUS_QUADRANT 7
 
-Helios::State Helios::cur_state;
-Helios::Flags Helios::global_flags;
-uint8_t Helios::menu_selection;
-uint8_t Helios::cur_mode;
-uint8_t Helios::selected_slot;
-uint8_t Helios::selected_base_quad;
-uint8_t Helios::selected_hue;
-uint8_t Helios::selected_sat;
-uint8_t Helios::selected_val;
-Pattern Helios::pat;
-bool Helios::keepgoing;
+HELIOS_TLS Helios::State Helios::cur_state;
+HELIOS_TLS Helios::Flags Helios::global_flags;
+HELIOS_TLS uint8_t Helios::menu_selection;
+HELIOS_TLS uint8_t Helios::cur_mode;
+HELIOS_TLS uint8_t Helios::selected_slot;
+HELIOS_TLS uint8_t Helios::selected_base_quad;
+HELIOS_TLS uint8_t Helios::selected_hue;
+HELIOS_TLS uint8_t Helios::selected_sat;
+HELIOS_TLS uint8_t Helios::selected_val;
+HELIOS_TLS Pattern Helios::pat;
+HELIOS_TLS bool Helios::keepgoing;
 
 #ifdef HELIOS_CLI
-bool Helios::sleeping;
+HELIOS_TLS bool Helios::sleeping;
 #endif
 
 volatile char helios_version[] = HELIOS_VERSION_STR;
@@ -129,6 +129,8 @@ void Helios::tick()
 
 void Helios::enter_sleep()
 {
+  // anything saved has to be in storage before the device goes down
+  Storage::flush();
 #ifdef HELIOS_EMBEDDED
   // clear the led colors
   Led::clear();
@@ -200,6 +202,7 @@ void Helios::load_cur_mode()
 void Helios::save_cur_mode()
 {
   Storage::write_pattern(cur_mode, pat);
+  Storage::commit();
 }
 
 void Helios::load_global_flags()
@@ -226,6 +229,7 @@ void Helios::save_global_flags()
 {
   Storage::write_global_flags(global_flags);
   Storage::write_current_mode(cur_mode);
+  Storage::commit();
 }
 
 void Helios::set_mode_index(uint8_t mode_index)
@@ -836,3 +840,62 @@ void Helios::show_selection(RGBColor color)
   }
   Led::set(color);
 }
+
+#ifdef HELIOS_CLI
+uint32_t Helios::next_event_tick()
+{
+  uint32_t now = Time::getCurtime();
+  uint32_t next = UINT32_MAX;
+  // only an input can wake the device so nothing else needs checking
+  if (cur_state != STATE_SLEEP) {
+    if (cur_state != STATE_MODES) {
+      // the menus strobe and flash on their own so just run every tick
+      return now;
+    }
+    bool hasReleased = (Button::releaseCount() > 0);
+    if (has_flag(FLAG_LOCKED) && hasReleased) {
+      // this tick will put the device right back to sleep
+      return now;
+    }
+    // the hold duration the next tick will see
+    uint32_t holdDur = now - Button::pressTime();
+    if (Button::isPressed() && holdDur > FORCE_SLEEP_TIME + 1) {
+      // the led is held off and the pattern is paused until the release
+      return Button::nextEventTick(next);
+    }
+    if (Button::isPressed()) {
+      if (hasReleased && holdDur / MENU_HOLD_TIME == 5) {
+        // the randomizer menu sweeps the hue every tick
+        return now;
+      }
+      // the hold menus only change on the tick the hold reaches a threshold
+      uint32_t threshold = ((holdDur + MENU_HOLD_TIME - 1) / MENU_HOLD_TIME) * MENU_HOLD_TIME;
+      if (holdDur <= SHORT_CLICK_THRESHOLD + 1 && SHORT_CLICK_THRESHOLD + 1 < threshold) {
+        threshold = SHORT_CLICK_THRESHOLD + 1;
+      }
+      if (FORCE_SLEEP_TIME + 1 < threshold) {
+        threshold = FORCE_SLEEP_TIME + 1;
+      }
+      next = now + (threshold - holdDur);
+    }
+    if (!has_flag(FLAG_LOCKED) && hasReleased) {
+      // the pattern keeps playing underneath the hold menus
+      uint32_t patEvent = pat.nextEventTick();
+      if (patEvent < next) {
+        next = patEvent;
+      }
+    }
+  }
+  // the next queued input can always change things, but there's
+  // no need to look past the next event that was already found
+  return Button::nextEventTick(next);
+}
+
+void Helios::skip_to(uint32_t tick)
+{
+  uint32_t numTicks = tick - Time::getCurtime();
+  // the button has to catch up before the clock moves
+  Button::skipTicks(numTicks);
+  Time::advance(numTicks);
+}
+#endif
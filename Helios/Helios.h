@@ -26,6 +26,15 @@ public:
 #ifdef HELIOS_CLI
   static bool is_asleep() { return sleeping; }
   static Pattern &cur_pattern() { return pat; }
+  // the current state and mode index for reports on the device
+  static uint8_t cur_state_index() { return cur_state; }
+  static uint8_t cur_mode_index() { return cur_mode; }
+
+  // the next tick that will change anything, every tick between now and then
+  // would repeat the last one exactly, UINT32_MAX if nothing will ever change
+  static uint32_t next_event_tick();
+  // jump straight to a tick at or before the next_event_tick()
+  static void skip_to(uint32_t tick);
 #endif
 
   enum Flags : uint8_t {
@@ -91,23 +100,26 @@ private:
   };
 
   // the current state of the system
-  static State cur_state;
+  static HELIOS_TLS State cur_state;
   // global flags for the entire system
-  static Flags global_flags;
-  static uint8_t menu_selection;
-  static uint8_t cur_mode;
+  static HELIOS_TLS Flags global_flags;
+  static HELIOS_TLS uint8_t menu_selection;
+  static HELIOS_TLS uint8_t cur_mode;
   // the quadrant that was selected in color select
-  static uint8_t selected_slot;
-  static uint8_t selected_base_quad;
-  static uint8_t selected_hue;
-  static uint8_t selected_sat;
-  static uint8_t selected_val;
+  static HELIOS_TLS uint8_t selected_slot;
+  static HELIOS_TLS uint8_t selected_base_quad;
+  static HELIOS_TLS uint8_t selected_hue;
+  static HELIOS_TLS uint8_t selected_sat;
+  static HELIOS_TLS uint8_t selected_val;
   static PatternArgs default_args[6];
   static Colorset default_colorsets[6];
-  static Pattern pat;
-  static bool keepgoing;
+  static HELIOS_TLS Pattern pat;
+  static HELIOS_TLS bool keepgoing;
 
 #ifdef HELIOS_CLI
-  static bool sleeping;
+  static HELIOS_TLS bool sleeping;
+
+  // the engine context swaps these globals in and out for each device
+  friend class HeliosEngine;
 #endif
 };
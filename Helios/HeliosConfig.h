@@ -153,9 +153,9 @@
 // Storage Size
 //
 // The total size of storage where modes and global settings are saved.
-// The EEPROM on attiny85 is 512 bytes, but due to limitations on flash
-// only the lower half of the eeprom is being used
-#define STORAGE_SIZE 256
+// This is the whole 512 byte EEPROM of the attiny85, the saves are wear
+// leveled across all of it (see Storage.h)
+#define STORAGE_SIZE 512
 
 // Colorset Size
 //
@@ -175,17 +175,47 @@
 
 // Slot Size
 //
-// the slot stores the pattern + 1 byte CRC
-#define SLOT_SIZE (PATTERN_SIZE + 1)
+// the slot record stores the slot number + 1 byte sequence + the pattern
+// + 1 byte CRC
+#define SLOT_SIZE (PATTERN_SIZE + 3)
 
 // Some math to calculate storage sizes:
 // 3 * 6 = 18 for the colorset
-// 1 + 7 + 1 + 1 = 10 for the rest
-//  = 28 bytes total for a pattern including CRC
-//    -> 8 slots = 8 * 28 = 224
-//      = 31 bytes left
-//    -> 9 slots = 9 * 28 = 252
-//      = 3 bytes left
+// 1 + 6 + 1 = 8 for the rest of the pattern
+// 1 + 1 + 1 = 3 for the slot number, sequence and CRC
+//  = 29 bytes total for a slot record
+//    -> 26 config records = 26 * 5 = 130
+//    -> 13 slot records = 13 * 29 = 377
+//    -> 2 bytes for the layout magic and version
+//      = 509 bytes of the 512 byte eeprom
+
+// Storage Write Queue
+//
+// Saves go into a queue that the eeprom ready interrupt writes out a byte
+// at a time so the tick loop never waits on the eeprom. It should hold a
+// whole slot record and must be a power of 2
+#define STORAGE_QUEUE_SIZE 32
+
+// EEPROM Write Time
+//
+// How long the eeprom takes to erase and write one byte in microseconds,
+// the CLI uses this to model how long the device waits on storage
+#define EEPROM_WRITE_US 3400
+
+// ============================================================================
+//  Engine State
+//
+//  The engine is made of static classes because the chip only ever runs
+//  one device, but the CLI and HeliosLib simulate many devices in one
+//  process. In those builds every engine global is thread local and a
+//  HeliosEngine swaps the state of one device in and out of the globals
+//  of whichever thread is driving it
+
+#ifdef HELIOS_CLI
+#define HELIOS_TLS thread_local
+#else
+#define HELIOS_TLS
+#endif
 
 // forbidden constant:
 // #define HELIOS_ARDUINO 1
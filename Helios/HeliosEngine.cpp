@@ -0,0 +1,459 @@
+#include "HeliosEngine.h"
+
+#ifdef HELIOS_CLI
+
+#include <string.h>
+#include <ctype.h>
+
+#include "Helios.h"
+#include "TimeControl.h"
+#include "Storage.h"
+#include "Button.h"
+#include "Led.h"
+
+// exchange a global with the copy held by the engine, the globals are
+// sometimes private enums so the engine stores them as plain integers
+template <typename T, typename U>
+static void swap_global(T &global, U &local)
+{
+  U tmp = (U)global;
+  global = (T)local;
+  local = tmp;
+}
+
+// arrays are exchanged whole through a buffer
+template <typename T, size_t N>
+static void swap_global(T (&global)[N], T (&local)[N])
+{
+  T tmp[N];
+  memcpy(tmp, global, sizeof(tmp));
+  memcpy(global, local, sizeof(tmp));
+  memcpy(local, tmp, sizeof(tmp));
+}
+
+HeliosEngine::HeliosEngine() :
+  m_bound(false),
+  m_curState(0),
+  m_globalFlags(0),
+  m_menuSelection(0),
+  m_curMode(0),
+  m_selectedSlot(0),
+  m_selectedBaseQuad(0),
+  m_selectedHue(0),
+  m_selectedSat(0),
+  m_selectedVal(0),
+  m_pat(),
+  m_enableTimeline(Pattern::isTimelineEnabled()),
+  m_keepGoing(false),
+  m_sleeping(false),
+  m_pressTime(0),
+  m_releaseTime(0),
+  m_holdDuration(0),
+  m_releaseDuration(0),
+  m_releaseCount(0),
+  m_buttonState(false),
+  m_newPress(false),
+  m_newRelease(false),
+  m_isPressed(false),
+  m_shortClick(false),
+  m_longClick(false),
+  m_holdClick(false),
+  m_inputQueue(),
+  m_numInputs(0),
+  m_pinState(false),
+  m_enableWake(false),
+  m_brightness(DEFAULT_BRIGHTNESS),
+  m_ledColor(RGB_OFF),
+  m_realColor(RGB_OFF),
+  m_curTick(0),
+  m_prevTime(0),
+  m_enableTimestep(false),
+  m_spinTimestep(false),
+  m_tickDeadline(0),
+  m_timestepStats(),
+  m_enableStorage(true),
+  m_storageImage(m_storage),
+  m_storage(),
+  m_storageLayout(),
+  m_numReads(0),
+  m_numWrites(0),
+  m_numFlushes(0),
+  m_queueHead(0),
+  m_queueTail(0),
+  m_queueFill(0),
+  m_queueAddr(),
+  m_queueData(),
+  m_busyUntil(0),
+  m_stallTick(0),
+  m_tickStall(0),
+  m_syncWrites(false),
+  m_writeStats(),
+  m_wearStats(),
+  m_storageModel(),
+  m_storageModelPtr(&m_storageModel)
+#if ALTERNATIVE_HSV_RGB == 1
+  , m_hsvRgbAlg(HSV_TO_RGB_GENERIC)
+#endif
+{
+}
+
+HeliosEngine::HeliosEngine(const HeliosEngine &other) :
+  HeliosEngine()
+{
+  *this = other;
+}
+
+HeliosEngine &HeliosEngine::operator=(const HeliosEngine &other)
+{
+  if (this == &other) {
+    return *this;
+  }
+  bool wasBound = m_bound;
+  unbind();
+  // Helios
+  m_curState = other.m_curState;
+  m_globalFlags = other.m_globalFlags;
+  m_menuSelection = other.m_menuSelection;
+  m_curMode = other.m_curMode;
+  m_selectedSlot = other.m_selectedSlot;
+  m_selectedBaseQuad = other.m_selectedBaseQuad;
+  m_selectedHue = other.m_selectedHue;
+  m_selectedSat = other.m_selectedSat;
+  m_selectedVal = other.m_selectedVal;
+  m_pat = other.m_pat;
+  m_enableTimeline = other.m_enableTimeline;
+  m_keepGoing = other.m_keepGoing;
+  m_sleeping = other.m_sleeping;
+  // Button
+  m_pressTime = other.m_pressTime;
+  m_releaseTime = other.m_releaseTime;
+  m_holdDuration = other.m_holdDuration;
+  m_releaseDuration = other.m_releaseDuration;
+  m_releaseCount = other.m_releaseCount;
+  m_buttonState = other.m_buttonState;
+  m_newPress = other.m_newPress;
+  m_newRelease = other.m_newRelease;
+  m_isPressed = other.m_isPressed;
+  m_shortClick = other.m_shortClick;
+  m_longClick = other.m_longClick;
+  m_holdClick = other.m_holdClick;
+  m_inputQueue = other.m_inputQueue;
+  m_numInputs = other.m_numInputs;
+  m_pinState = other.m_pinState;
+  m_enableWake = other.m_enableWake;
+  // Led
+  m_brightness = other.m_brightness;
+  m_ledColor = other.m_ledColor;
+  m_realColor = other.m_realColor;
+  // Time
+  m_curTick = other.m_curTick;
+  m_prevTime = other.m_prevTime;
+  m_enableTimestep = other.m_enableTimestep;
+  m_spinTimestep = other.m_spinTimestep;
+  m_tickDeadline = other.m_tickDeadline;
+  m_timestepStats = other.m_timestepStats;
+  // Storage, the copy points at it's own image unless the other engine
+  // was using the storage file
+  m_enableStorage = other.m_enableStorage;
+  memcpy(m_storage, other.m_storage, sizeof(m_storage));
+  m_storageImage = (other.m_storageImage == other.m_storage) ? m_storage : other.m_storageImage;
+  m_storageLayout = other.m_storageLayout;
+  m_numReads = other.m_numReads;
+  m_numWrites = other.m_numWrites;
+  m_numFlushes = other.m_numFlushes;
+  // the writes still waiting on the eeprom
+  m_queueHead = other.m_queueHead;
+  m_queueTail = other.m_queueTail;
+  m_queueFill = other.m_queueFill;
+  memcpy(m_queueAddr, other.m_queueAddr, sizeof(m_queueAddr));
+  memcpy(m_queueData, other.m_queueData, sizeof(m_queueData));
+  m_busyUntil = other.m_busyUntil;
+  m_stallTick = other.m_stallTick;
+  m_tickStall = other.m_tickStall;
+  m_syncWrites = other.m_syncWrites;
+  m_writeStats = other.m_writeStats;
+  // how much the saves wore the eeprom
+  m_wearStats = other.m_wearStats;
+  // the copy keeps pointing at it's own model
+  m_storageModel = other.m_storageModel;
+#if ALTERNATIVE_HSV_RGB == 1
+  m_hsvRgbAlg = other.m_hsvRgbAlg;
+#endif
+  if (wasBound) {
+    bind();
+  }
+  return *this;
+}
+
+HeliosEngine::~HeliosEngine()
+{
+  if (m_bound) {
+    unbind();
+  }
+}
+
+bool HeliosEngine::init()
+{
+  bind();
+  bool success = Helios::init();
+  unbind();
+  return success;
+}
+
+void HeliosEngine::tick()
+{
+  bind();
+  Helios::tick();
+  unbind();
+}
+
+uint32_t HeliosEngine::run(uint32_t numTicks)
+{
+  bind();
+  uint32_t ticks = 0;
+  while (ticks < numTicks && Helios::keep_going()) {
+    Helios::tick();
+    ticks++;
+  }
+  unbind();
+  return ticks;
+}
+
+void HeliosEngine::bind()
+{
+  if (m_bound) {
+    return;
+  }
+  swapState();
+  m_bound = true;
+}
+
+void HeliosEngine::unbind()
+{
+  if (!m_bound) {
+    return;
+  }
+  swapState();
+  m_bound = false;
+}
+
+void HeliosEngine::queueInput(char input, uint32_t count)
+{
+  if (m_bound) {
+    Button::queueInput(input, count);
+    return;
+  }
+  if (!count) {
+    return;
+  }
+  // the same as the button queue, repeats make the last run longer
+  m_numInputs += count;
+  if (!m_inputQueue.empty() && m_inputQueue.back().command == input) {
+    m_inputQueue.back().count += count;
+    return;
+  }
+  m_inputQueue.push_back({input, count});
+}
+
+void HeliosEngine::queueInputs(const char *inputs)
+{
+  if (!inputs) {
+    return;
+  }
+  // repeats are queued as a single run so long waits cost nothing
+  const char *end = inputs + strlen(inputs);
+  char command = 0;
+  uint32_t count = 0;
+  while (nextInputRun(inputs, end, command, count)) {
+    queueInput(command, count);
+  }
+}
+
+bool HeliosEngine::nextInputRun(const char *&inputs, const char *end, char &command, uint32_t &count)
+{
+  // skip any whitespace, it would otherwise clog the input queue
+  while (inputs < end && isspace((unsigned char)*inputs)) {
+    inputs++;
+  }
+  // read a repeat count in front of the command if there is one
+  const char *pos = inputs;
+  uint32_t repeatAmount = 1;
+  if (pos < end && isdigit((unsigned char)*pos)) {
+    repeatAmount = 0;
+    while (pos < end && isdigit((unsigned char)*pos)) {
+      repeatAmount = (repeatAmount * 10) + (*pos - '0');
+      pos++;
+    }
+  }
+  if (pos >= end) {
+    return false;
+  }
+  command = *pos;
+  count = repeatAmount;
+  inputs = pos + 1;
+  return true;
+}
+
+std::vector<Button::InputRun> HeliosEngine::inputRuns(const char *inputs)
+{
+  std::vector<Button::InputRun> runs;
+  if (!inputs) {
+    return runs;
+  }
+  const char *end = inputs + strlen(inputs);
+  char command = 0;
+  uint32_t count = 0;
+  while (nextInputRun(inputs, end, command, count)) {
+    if (!count) {
+      continue;
+    }
+    // the same as the button queue, repeats make the last run longer
+    if (!runs.empty() && runs.back().command == command) {
+      runs.back().count += count;
+      continue;
+    }
+    runs.push_back({command, count});
+  }
+  return runs;
+}
+
+void HeliosEngine::enableStorage(bool enabled)
+{
+  if (m_bound) {
+    Storage::enableStorage(enabled);
+    return;
+  }
+  m_enableStorage = enabled;
+}
+
+void HeliosEngine::enableTimestep(bool enabled)
+{
+  if (m_bound) {
+    Time::enableTimestep(enabled);
+    return;
+  }
+  m_enableTimestep = enabled;
+}
+
+void HeliosEngine::enableTimeline(bool enabled)
+{
+  if (m_bound) {
+    Pattern::enableTimeline(enabled);
+    return;
+  }
+  m_enableTimeline = enabled;
+}
+
+bool HeliosEngine::keepGoing() const
+{
+  return m_bound ? Helios::keep_going() : m_keepGoing;
+}
+
+bool HeliosEngine::isAsleep() const
+{
+  return m_bound ? Helios::is_asleep() : m_sleeping;
+}
+
+uint32_t HeliosEngine::curTick() const
+{
+  return m_bound ? Time::getCurtime() : m_curTick;
+}
+
+RGBColor HeliosEngine::ledColor() const
+{
+  return m_bound ? Led::get() : m_ledColor;
+}
+
+uint32_t HeliosEngine::inputQueueSize() const
+{
+  return m_bound ? Button::inputQueueSize() : m_numInputs;
+}
+
+void HeliosEngine::swapPattern(Pattern &global, Pattern &local)
+{
+  // the timelines are taken out first so copying the patterns doesn't have
+  // to count references to them
+  std::shared_ptr<const PatternTimeline> globalTimeline;
+  std::shared_ptr<const PatternTimeline> localTimeline;
+  globalTimeline.swap(global.m_timeline);
+  localTimeline.swap(local.m_timeline);
+  // and they go through a spare pattern that is assigned to rather than
+  // constructed each time, constructing a colorset sets up a default one
+  static HELIOS_TLS Pattern spare;
+  spare = global;
+  global = local;
+  local = spare;
+  global.m_timeline.swap(localTimeline);
+  local.m_timeline.swap(globalTimeline);
+}
+
+void HeliosEngine::swapState()
+{
+  // Helios
+  swap_global(Helios::cur_state, m_curState);
+  swap_global(Helios::global_flags, m_globalFlags);
+  swap_global(Helios::menu_selection, m_menuSelection);
+  swap_global(Helios::cur_mode, m_curMode);
+  swap_global(Helios::selected_slot, m_selectedSlot);
+  swap_global(Helios::selected_base_quad, m_selectedBaseQuad);
+  swap_global(Helios::selected_hue, m_selectedHue);
+  swap_global(Helios::selected_sat, m_selectedSat);
+  swap_global(Helios::selected_val, m_selectedVal);
+  swapPattern(Helios::pat, m_pat);
+  swap_global(Pattern::m_enableTimeline, m_enableTimeline);
+  swap_global(Helios::keepgoing, m_keepGoing);
+  swap_global(Helios::sleeping, m_sleeping);
+  // Button
+  swap_global(Button::m_pressTime, m_pressTime);
+  swap_global(Button::m_releaseTime, m_releaseTime);
+  swap_global(Button::m_holdDuration, m_holdDuration);
+  swap_global(Button::m_releaseDuration, m_releaseDuration);
+  swap_global(Button::m_releaseCount, m_releaseCount);
+  swap_global(Button::m_buttonState, m_buttonState);
+  swap_global(Button::m_newPress, m_newPress);
+  swap_global(Button::m_newRelease, m_newRelease);
+  swap_global(Button::m_isPressed, m_isPressed);
+  swap_global(Button::m_shortClick, m_shortClick);
+  swap_global(Button::m_longClick, m_longClick);
+  swap_global(Button::m_holdClick, m_holdClick);
+  // the queue can be swapped without copying the contents
+  Button::m_inputQueue.swap(m_inputQueue);
+  swap_global(Button::m_numInputs, m_numInputs);
+  swap_global(Button::m_pinState, m_pinState);
+  swap_global(Button::m_enableWake, m_enableWake);
+  // Led
+  swap_global(Led::m_brightness, m_brightness);
+  swap_global(Led::m_ledColor, m_ledColor);
+  swap_global(Led::m_realColor, m_realColor);
+  // Time
+  swap_global(Time::m_curTick, m_curTick);
+  swap_global(Time::m_prevTime, m_prevTime);
+  swap_global(Time::m_enableTimestep, m_enableTimestep);
+  swap_global(Time::m_spinTimestep, m_spinTimestep);
+  swap_global(Time::m_tickDeadline, m_tickDeadline);
+  swap_global(Time::m_timestepStats, m_timestepStats);
+  // Storage
+  swap_global(Storage::m_enableStorage, m_enableStorage);
+  swap_global(Storage::m_storageImage, m_storageImage);
+  swap_global(Storage::m_layout, m_storageLayout);
+  swap_global(Storage::m_numReads, m_numReads);
+  swap_global(Storage::m_numWrites, m_numWrites);
+  swap_global(Storage::m_numFlushes, m_numFlushes);
+  swap_global(Storage::m_queueHead, m_queueHead);
+  swap_global(Storage::m_queueTail, m_queueTail);
+  swap_global(Storage::m_queueFill, m_queueFill);
+  swap_global(Storage::m_queueAddr, m_queueAddr);
+  swap_global(Storage::m_queueData, m_queueData);
+  swap_global(Storage::m_busyUntil, m_busyUntil);
+  swap_global(Storage::m_stallTick, m_stallTick);
+  swap_global(Storage::m_tickStall, m_tickStall);
+  swap_global(Storage::m_syncWrites, m_syncWrites);
+  swap_global(Storage::m_writeStats, m_writeStats);
+  swap_global(Storage::m_wearStats, m_wearStats);
+  swap_global(Storage::m_model, m_storageModelPtr);
+#if ALTERNATIVE_HSV_RGB == 1
+  swap_global(g_hsv_rgb_alg, m_hsvRgbAlg);
+#endif
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef HELIOS_ENGINE_H
+#define HELIOS_ENGINE_H
+
+#include <inttypes.h>
+
+#include "HeliosConfig.h"
+
+#ifdef HELIOS_CLI
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Colortypes.h"
+#include "Pattern.h"
+#include "Button.h"
+#include "Storage.h"
+#include "TimeControl.h"
+
+// The engine context of a single simulated device, this owns one device worth
+// of time, led, button, storage and pattern state.
+//
+// Helios is made of static classes because the chip only ever runs one device,
+// so rather than rewrite the whole engine around instances the engine globals
+// are thread local in the CLI and HeliosLib. Binding an engine swaps the state
+// of the device into the globals of the calling thread and unbinding swaps it
+// back out, so any number of engines can exist side by side and each thread
+// can drive one engine at a time without touching any other thread.
+class HeliosEngine
+{
+public:
+  HeliosEngine();
+  ~HeliosEngine();
+
+  // copying an engine snapshots the whole device, the copy carries on from
+  // exactly the same tick with it's own copy of the storage image and the
+  // pending inputs. This is how simulations fork from a shared prefix instead
+  // of replaying it. The engine being copied must not be bound, assigning to
+  // a bound engine leaves it bound with the new state
+  HeliosEngine(const HeliosEngine &other);
+  HeliosEngine &operator=(const HeliosEngine &other);
+
+  // initialize the device, this is the equivalent of Helios::init()
+  bool init();
+
+  // run a single tick of the device, this binds and unbinds the engine around
+  // the tick so use run() or bind the engine to run a lot of ticks
+  void tick();
+  // run up to numTicks ticks or until the device quits, returns the number
+  // of ticks that were actually run
+  uint32_t run(uint32_t numTicks);
+
+  // swap the state of this device into the engine globals of the calling thread
+  // so that the static Helios apis operate on this device, whatever the thread
+  // had in the globals is held by the engine until it is unbound. Binds must be
+  // unbound in reverse order if multiple engines are bound on one thread
+  void bind();
+  void unbind();
+  bool isBound() const { return m_bound; }
+
+  // queue up a single input event, a number of the same event in a row, or a
+  // string of input commands in the same format the CLI reads from stdin,
+  // ex: 300wcp1500wrq
+  void queueInput(char input, uint32_t count = 1);
+  void queueInputs(const char *inputs);
+  // read the next command and it's repeat count out of a string of input
+  // commands that runs up to end and move past them, whitespace is skipped.
+  // Returns false at the end or if the string ends in a repeat count
+  static bool nextInputRun(const char *&inputs, const char *end, char &command, uint32_t &count);
+  // read a string of input commands into exactly the runs queueInputs() would
+  // queue, ex: 3ww2c becomes the runs 4w and 2c
+  static std::vector<Button::InputRun> inputRuns(const char *inputs);
+
+  // toggle the in-memory storage image of this device, enabled by default
+  void enableStorage(bool enabled);
+  // toggle realtime timestep, disabled by default so devices run flat out
+  void enableTimestep(bool enabled);
+  // toggle whether patterns play from a compiled timeline, a new engine starts
+  // out with the setting of the thread that creates it
+  void enableTimeline(bool enabled);
+  // the in-memory eeprom image of this device
+  uint8_t *storage() { return m_storage; }
+
+  // various state of the device
+  bool keepGoing() const;
+  bool isAsleep() const;
+  uint32_t curTick() const;
+  RGBColor ledColor() const;
+  uint32_t inputQueueSize() const;
+
+  // the current pattern of the device, only use this while bound or before
+  // the first tick because the engine globals hold it while bound
+  Pattern &curPattern() { return m_pat; }
+
+private:
+  // exchange the state of this device with the engine globals
+  void swapState();
+  static void swapPattern(Pattern &global, Pattern &local);
+
+  // whether the engine state is currently in the globals
+  bool m_bound;
+
+  // Helios state
+  uint8_t m_curState;
+  uint8_t m_globalFlags;
+  uint8_t m_menuSelection;
+  uint8_t m_curMode;
+  uint8_t m_selectedSlot;
+  uint8_t m_selectedBaseQuad;
+  uint8_t m_selectedHue;
+  uint8_t m_selectedSat;
+  uint8_t m_selectedVal;
+  Pattern m_pat;
+  bool m_enableTimeline;
+  bool m_keepGoing;
+  bool m_sleeping;
+
+  // Button state
+  uint32_t m_pressTime;
+  uint32_t m_releaseTime;
+  uint32_t m_holdDuration;
+  uint32_t m_releaseDuration;
+  uint8_t m_releaseCount;
+  bool m_buttonState;
+  bool m_newPress;
+  bool m_newRelease;
+  bool m_isPressed;
+  bool m_shortClick;
+  bool m_longClick;
+  bool m_holdClick;
+  std::deque<Button::InputRun> m_inputQueue;
+  uint32_t m_numInputs;
+  bool m_pinState;
+  bool m_enableWake;
+
+  // Led state
+  uint8_t m_brightness;
+  RGBColor m_ledColor;
+  RGBColor m_realColor;
+
+  // Time state
+  uint32_t m_curTick;
+  uint32_t m_prevTime;
+  bool m_enableTimestep;
+  bool m_spinTimestep;
+  uint64_t m_tickDeadline;
+  Time::TimestepStats m_timestepStats;
+
+  // Storage state
+  bool m_enableStorage;
+  uint8_t *m_storageImage;
+  uint8_t m_storage[STORAGE_SIZE];
+  Storage::Layout m_storageLayout;
+  uint64_t m_numReads;
+  uint64_t m_numWrites;
+  uint64_t m_numFlushes;
+  uint8_t m_queueHead;
+  uint8_t m_queueTail;
+  uint8_t m_queueFill;
+  uint16_t m_queueAddr[STORAGE_QUEUE_SIZE];
+  uint8_t m_queueData[STORAGE_QUEUE_SIZE];
+  uint64_t m_busyUntil;
+  uint32_t m_stallTick;
+  uint64_t m_tickStall;
+  bool m_syncWrites;
+  Storage::WriteStats m_writeStats;
+  Storage::WearStats m_wearStats;
+  // the bulk of the eeprom models only has it's pointer swapped, like the
+  // storage image
+  Storage::Model m_storageModel;
+  Storage::Model *m_storageModelPtr;
+
+#if ALTERNATIVE_HSV_RGB == 1
+  hsv_to_rgb_algorithm m_hsvRgbAlg;
+#endif
+};
+
+#endif
+
+#endif
@@ -23,10 +23,10 @@
 #define SCALE8(i, scale)  (((uint16_t)i * (uint16_t)(scale)) >> 8)
 
 // array of led color values
-RGBColor Led::m_ledColor = RGB_OFF;
-RGBColor Led::m_realColor = RGB_OFF;
+HELIOS_TLS RGBColor Led::m_ledColor = RGB_OFF;
+HELIOS_TLS RGBColor Led::m_realColor = RGB_OFF;
 // global brightness
-uint8_t Led::m_brightness = DEFAULT_BRIGHTNESS;
+HELIOS_TLS uint8_t Led::m_brightness = DEFAULT_BRIGHTNESS;
 
 bool Led::init()
 {
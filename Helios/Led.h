@@ -51,11 +51,16 @@ private:
   static void setPWM(uint8_t pwmPin, uint8_t pwmValue, volatile uint8_t &controlRegister,
       uint8_t controlBit, volatile uint8_t &compareRegister);
 
+#ifdef HELIOS_CLI
+  // the engine context swaps these globals in and out for each device
+  friend class HeliosEngine;
+#endif
+
   // the global brightness
-  static uint8_t m_brightness;
+  static HELIOS_TLS uint8_t m_brightness;
   // led color
-  static RGBColor m_ledColor;
-  static RGBColor m_realColor;
+  static HELIOS_TLS RGBColor m_ledColor;
+  static HELIOS_TLS RGBColor m_realColor;
 };
 
 #endif
@@ -7,6 +7,13 @@
 #include "HeliosConfig.h"
 #include "Led.h"
 
+#ifdef HELIOS_CLI
+#include <vector>
+#include <map>
+
+#include "PatternTimeline.h"
+#endif
+
 #include <string.h> // for memcpy
 
 // uncomment me to print debug labels on the pattern states, this is useful if you
@@ -37,6 +44,15 @@ static void printState(PatternState state)
 #define PRINT_STATE(state) // do nothing
 #endif
 
+#ifdef HELIOS_CLI
+// whether patterns play from their compiled timeline
+HELIOS_TLS bool Pattern::m_enableTimeline = false;
+
+// the longest cycle that is rendered to find the period of the led output,
+// past this the period of the state is used even if the led repeats sooner
+#define MAX_PERIOD_FRAMES (1 << 22)
+#endif
+
 Pattern::Pattern(uint8_t onDur, uint8_t offDur, uint8_t gap,
           uint8_t dash, uint8_t group, uint8_t blend) :
   m_args(onDur, offDur, gap, dash, group, blend),
@@ -47,6 +63,17 @@ Pattern::Pattern(uint8_t onDur, uint8_t offDur, uint8_t gap,
   m_blinkTimer(),
   m_cur(),
   m_next()
+#ifdef HELIOS_CLI
+  ,
+  m_timeline(),
+  m_segment(0),
+  m_segmentStart(0),
+  m_segmentLength(0),
+  m_timelineSync(false),
+  m_hash(0),
+  m_hashValid(false),
+  m_simulating(false)
+#endif
 {
 }
 
@@ -62,6 +89,11 @@ Pattern::~Pattern()
 
 void Pattern::init()
 {
+#ifdef HELIOS_CLI
+  // the state machine has to find the first segment again
+  m_timelineSync = false;
+#endif
+  changed();
   m_colorset.resetIndex();
 
   // the default state to begin with
@@ -86,6 +118,13 @@ void Pattern::init()
 
 void Pattern::play()
 {
+#ifdef HELIOS_CLI
+  // walk the compiled timeline instead of the state machine when possible
+  if (m_timelineSync && playTimeline()) {
+    return;
+  }
+#endif
+
   // Sometimes the pattern needs to cycle multiple states in a single frame so
   // instead of using a loop or recursion I have just used a simple goto
 replay:
@@ -174,6 +213,7 @@ replay:
 void Pattern::setArgs(const PatternArgs &args)
 {
   memcpy(&m_args, &args, sizeof(PatternArgs));
+  changed();
 }
 
 void Pattern::onBlinkOn()
@@ -204,21 +244,342 @@ void Pattern::beginDash()
   Led::set(m_colorset.getNext());
 }
 
+#ifdef HELIOS_CLI
+uint32_t Pattern::nextEventTick() const
+{
+  switch (m_state) {
+  case STATE_DISABLED:
+    return UINT32_MAX;
+  case STATE_ON:
+  case STATE_OFF:
+  case STATE_IN_GAP:
+  case STATE_IN_DASH:
+  case STATE_IN_GAP2:
+    // holding a color until the blink timer fires
+    return m_blinkTimer.nextAlarm();
+  default:
+    // the blink and begin states all act on the very next play
+    return Time::getCurtime();
+  }
+}
+#endif
+
 void Pattern::nextState(uint8_t timing)
 {
   m_blinkTimer.init(timing);
   m_state = (PatternState)(m_state + 1);
+#ifdef HELIOS_CLI
+  // a new segment just began so the timeline can pick up from here
+  syncTimeline();
+#endif
+}
+
+#ifdef HELIOS_CLI
+bool Pattern::playTimeline()
+{
+  uint32_t now = Time::getCurtime();
+  uint32_t elapsed = now - m_segmentStart;
+  // this is the only check most ticks ever make
+  if (elapsed < m_segmentLength) {
+    return true;
+  }
+  // anything but landing right on the end of the segment means the clock
+  // jumped, and a different crc means the pattern was changed in the middle
+  // of the segment, either way the state machine has to take over again
+  if (elapsed != m_segmentLength || m_timeline->hash() != timelineHash()) {
+    m_timelineSync = false;
+    return false;
+  }
+  m_segment = m_timeline->next(m_segment);
+  const PatternTimeline::Segment &seg = m_timeline->segment(m_segment);
+  // put the pattern where the state machine would be at this point
+  m_state = (PatternState)seg.state;
+  m_groupCounter = seg.groupCounter;
+  m_colorset.setCurIndex(seg.curIndex);
+  m_blinkTimer.init(seg.duration);
+  Led::set(seg.color);
+  m_segmentStart = now;
+  m_segmentLength = seg.duration;
+  return true;
 }
 
+void Pattern::syncTimeline()
+{
+  m_timelineSync = false;
+  if (!m_enableTimeline || m_simulating || isBlend()) {
+    return;
+  }
+  uint32_t segment = UINT32_MAX;
+  if (m_timeline && m_timeline->hash() == timelineHash()) {
+    segment = m_timeline->find(m_state, m_groupCounter, m_colorset.curIndex());
+  }
+  if (segment == UINT32_MAX) {
+    // compile a new timeline that begins with this segment
+    m_timeline = PatternTimeline::compile(*this);
+    if (!m_timeline) {
+      return;
+    }
+    segment = 0;
+  }
+  m_segment = segment;
+  m_segmentStart = Time::getCurtime();
+  m_segmentLength = m_timeline->segment(segment).duration;
+  m_timelineSync = true;
+}
+
+uint32_t Pattern::timelineHash()
+{
+  if (!m_hashValid) {
+    m_hash = crc32();
+    m_hashValid = true;
+  }
+  return m_hash;
+}
+
+void Pattern::seek(uint32_t ticks)
+{
+  init();
+  if (!ticks) {
+    return;
+  }
+  std::shared_ptr<const PatternTimeline> timeline = beginSimulation();
+  if (m_state == STATE_DISABLED) {
+    m_simulating = false;
+    return;
+  }
+  // the number of ticks into the current segment after the last tick
+  uint32_t elapsed = 0;
+  if (!timeline) {
+    // the pattern is too long to compile, so skip one segment at a time
+    uint32_t played = 0;
+    while (played + stateDuration() < ticks) {
+      played += stateDuration();
+      skipSegment();
+    }
+    elapsed = ticks - played;
+  } else {
+    uint32_t lead = timeline->leadTicks();
+    uint32_t period = timeline->loopTicks();
+    // find the number of whole loops and the position in the loop of the last tick
+    uint32_t last = ticks - 1;
+    uint32_t loops = 0;
+    uint32_t pos = last;
+    if (last >= lead) {
+      loops = (last - lead) / period;
+      pos = lead + ((last - lead) % period);
+    }
+    uint32_t segment = timeline->findTick(pos);
+    elapsed = pos - timeline->segmentStart(segment) + 1;
+    uint32_t first = 0;
+    if (last >= lead) {
+      for (uint32_t i = 0; i < timeline->loopStart(); ++i) {
+        skipSegment();
+      }
+      // jump straight to the loop in the cycle that lines up with the target
+      std::vector<uint64_t> keys;
+      uint32_t cycleStart = 0;
+      if (findLoopCycle(*timeline, loops, keys, cycleStart)) {
+        uint32_t cycleLength = (uint32_t)keys.size() - cycleStart;
+        setLoopKey(keys[cycleStart + ((loops - cycleStart) % cycleLength)]);
+      }
+      first = timeline->loopStart();
+    }
+    for (uint32_t i = first; i < segment; ++i) {
+      skipSegment();
+    }
+  }
+  // the led only changes when a segment begins so show what that segment set
+  Led::set(segmentColor());
+  m_simulating = false;
+  // the segment began far enough back that it ends right on time
+  m_blinkTimer.start((uint32_t)0 - elapsed);
+  syncTimeline();
+  if (m_timelineSync) {
+    m_segmentStart = Time::getCurtime() - elapsed;
+  }
+}
+
+uint32_t Pattern::period() const
+{
+  uint32_t start = 0;
+  uint32_t length = 0;
+  computePeriod(start, length);
+  return length;
+}
+
+uint32_t Pattern::periodStart() const
+{
+  uint32_t start = 0;
+  uint32_t length = 0;
+  computePeriod(start, length);
+  return start;
+}
+
+void Pattern::computePeriod(uint32_t &start, uint32_t &length) const
+{
+  // run a copy from the start, that sets the led so put it back afterwards
+  RGBColor led = Led::get();
+  Pattern sim(*this);
+  sim.m_timeline.reset();
+  sim.init();
+  std::shared_ptr<const PatternTimeline> timeline = sim.beginSimulation();
+  start = 0;
+  length = 0;
+  if (sim.m_state == STATE_DISABLED) {
+    // the led just stays off
+    length = 1;
+  } else if (timeline) {
+    for (uint32_t i = 0; i < timeline->loopStart(); ++i) {
+      sim.skipSegment();
+    }
+    // every loop plays the same segments so the pattern repeats as soon as the
+    // blend colors and colorset index at the start of a loop come back around
+    std::vector<uint64_t> keys;
+    uint32_t cycleStart = 0;
+    sim.findLoopCycle(*timeline, UINT32_MAX, keys, cycleStart);
+    uint64_t loops = keys.size() - cycleStart;
+    uint64_t lead = timeline->leadTicks() + (uint64_t)cycleStart * timeline->loopTicks();
+    uint64_t ticks = loops * timeline->loopTicks();
+    // different states can show the same colors, like a blend that passes
+    // through the same colors starting from each color of the colorset, so
+    // the led can repeat sooner than the state does
+    if (ticks <= MAX_PERIOD_FRAMES) {
+      ticks = sim.outputPeriod(*timeline, (uint32_t)loops);
+    }
+    start = (lead < UINT32_MAX) ? (uint32_t)lead : UINT32_MAX;
+    length = (ticks < UINT32_MAX) ? (uint32_t)ticks : UINT32_MAX;
+  }
+  Led::set(led);
+}
+
+std::shared_ptr<const PatternTimeline> Pattern::beginSimulation()
+{
+  // the state machine is stepped directly so keep the timeline out of it
+  m_simulating = true;
+  // the first tick begins the first segment
+  play();
+  if (m_state == STATE_DISABLED) {
+    return nullptr;
+  }
+  // blends pass through the very same segments as the plain pattern, they
+  // only pick different colors, so the timeline of the plain pattern has
+  // the timing of every segment either way
+  Pattern plain(*this);
+  plain.m_args.blend_speed = 0;
+  return PatternTimeline::compile(plain);
+}
+
+bool Pattern::findLoopCycle(const PatternTimeline &timeline, uint32_t maxLoops,
+  std::vector<uint64_t> &keys, uint32_t &cycleStart)
+{
+  std::map<uint64_t, uint32_t> seen;
+  while (1) {
+    uint64_t key = ((uint64_t)m_cur.raw() << 32) | ((uint64_t)m_next.raw() << 8) | m_colorset.curIndex();
+    std::map<uint64_t, uint32_t>::const_iterator it = seen.find(key);
+    if (it != seen.end()) {
+      cycleStart = it->second;
+      return true;
+    }
+    seen[key] = (uint32_t)keys.size();
+    keys.push_back(key);
+    if (keys.size() > maxLoops) {
+      return false;
+    }
+    for (uint32_t i = timeline.loopStart(); i < timeline.numSegments(); ++i) {
+      skipSegment();
+    }
+  }
+}
+
+uint32_t Pattern::outputPeriod(const PatternTimeline &timeline, uint32_t loops)
+{
+  // render every tick of the cycle, the led only changes when a segment begins
+  std::vector<uint32_t> frames;
+  for (uint32_t loop = 0; loop < loops; ++loop) {
+    for (uint32_t i = timeline.loopStart(); i < timeline.numSegments(); ++i) {
+      frames.insert(frames.end(), timeline.segment(i).duration, segmentColor().raw());
+      skipSegment();
+    }
+  }
+  // the frames repeat at some divisor of the cycle, so divide out one prime
+  // factor at a time for as long as the frames still repeat
+  uint32_t length = (uint32_t)frames.size();
+  uint32_t period = length;
+  uint32_t rest = length;
+  for (uint32_t factor = 2; rest > 1; ++factor) {
+    if (factor * factor > rest) {
+      // whatever is left is prime
+      factor = rest;
+    }
+    while (rest % factor == 0) {
+      rest /= factor;
+      uint32_t shorter = period / factor;
+      uint32_t t = 0;
+      while (t + shorter < length && frames[t] == frames[t + shorter]) {
+        ++t;
+      }
+      if (t + shorter == length) {
+        period = shorter;
+      }
+    }
+  }
+  return period;
+}
+
+RGBColor Pattern::segmentColor()
+{
+  if (m_state == STATE_ON && isBlend()) {
+    return m_cur;
+  }
+  if (m_state == STATE_ON || m_state == STATE_IN_DASH) {
+    return m_colorset.cur();
+  }
+  return RGB_OFF;
+}
+
+void Pattern::setLoopKey(uint64_t key)
+{
+  m_cur = RGBColor((uint32_t)(key >> 32));
+  m_next = RGBColor((uint32_t)(key >> 8) & 0xFFFFFF);
+  m_colorset.setCurIndex(key & 0xFF);
+}
+
+void Pattern::skipSegment()
+{
+  // a timer that starts on this tick fires on this tick
+  m_blinkTimer.start();
+  play();
+}
+
+uint8_t Pattern::stateDuration() const
+{
+  switch (m_state) {
+  case STATE_ON:
+    return m_args.on_dur;
+  case STATE_OFF:
+    return m_args.off_dur;
+  case STATE_IN_GAP:
+  case STATE_IN_GAP2:
+    return m_args.gap_dur;
+  case STATE_IN_DASH:
+    return m_args.dash_dur;
+  default:
+    return 0;
+  }
+}
+#endif
+
 // change the colorset
 void Pattern::setColorset(const Colorset &set)
 {
   m_colorset = set;
+  changed();
 }
 
 void Pattern::clearColorset()
 {
   m_colorset.clear();
+  changed();
 }
 
 bool Pattern::equals(const Pattern *other)
@@ -6,6 +6,13 @@
 #include "Timer.h"
 #include "Patterns.h"
 
+#ifdef HELIOS_CLI
+#include <memory>
+#include <vector>
+
+class PatternTimeline;
+#endif
+
 // for specifying things like default args
 struct PatternArgs {
   PatternArgs(uint8_t on = 0, uint8_t off = 0, uint8_t gap = 0, uint8_t dash = 0, uint8_t group = 0, uint8_t blend = 0) :
@@ -37,12 +44,12 @@ public:
   void setArgs(const PatternArgs &args);
   const PatternArgs getArgs() const { return m_args; }
   PatternArgs getArgs() { return m_args; }
-  PatternArgs &args() { return m_args; }
+  PatternArgs &args() { changed(); return m_args; }
 
   // change the colorset
   const Colorset getColorset() const { return m_colorset; }
   Colorset getColorset() { return m_colorset; }
-  Colorset &colorset() { return m_colorset; }
+  Colorset &colorset() { changed(); return m_colorset; }
   void setColorset(const Colorset &set);
   void clearColorset();
 
@@ -62,6 +69,32 @@ public:
   // whether blend speed is non 0
   bool isBlend() const { return m_args.blend_speed > 0; }
 
+#ifdef HELIOS_CLI
+  // the next tick that play() will change the state of the pattern or the
+  // led, UINT32_MAX if the pattern will never change again
+  uint32_t nextEventTick() const;
+
+  // initialize the pattern and fast forward it as if play() had been called
+  // once per tick for the given number of ticks, with the last of those ticks
+  // being the one right before the current tick. The cost only depends on the
+  // size of the pattern not the number of ticks, then the next play() picks up
+  // exactly where the pattern would have been
+  void seek(uint32_t ticks);
+
+  // the exact number of ticks the pattern takes to repeat itself, this is
+  // worked out from the args and colorset and includes the cycle the blend
+  // colors settle into. Returns 0 if it can't be worked out
+  uint32_t period() const;
+  // the number of ticks after init() before the pattern begins repeating, ie
+  // the time a blend takes to settle into its cycle
+  uint32_t periodStart() const;
+
+  // toggle whether patterns play from a compiled timeline, when disabled
+  // every tick runs through the state machine instead (default disabled)
+  static void enableTimeline(bool enabled) { m_enableTimeline = enabled; }
+  static bool isTimelineEnabled() { return m_enableTimeline; }
+#endif
+
 protected:
   // ==================================
   //  Pattern Parameters
@@ -129,6 +162,69 @@ protected:
   // apis for blend
   void blendBlinkOn();
   void interpolate(uint8_t &current, const uint8_t next);
+
+#ifdef HELIOS_CLI
+  // the pattern may be about to change so the crc has to be worked out again
+  void changed() { m_hashValid = false; }
+#else
+  void changed() {}
+#endif
+
+#ifdef HELIOS_CLI
+  // the timeline is compiled by running the state machine of a copy
+  friend class PatternTimeline;
+  // the batch reads the segments and starting state of it's patterns
+  friend class PatternBatch;
+  // the engine context swaps the timeline setting in and out for each device
+  friend class HeliosEngine;
+
+  // play the current segment of the timeline, returns false if the pattern
+  // has to go back to the state machine to work out what comes next
+  bool playTimeline();
+  // find the segment that just began in the timeline, compiling it if needed
+  void syncTimeline();
+  // the crc of the pattern to check the timeline against, it's only worked
+  // out again after something could have changed the pattern
+  uint32_t timelineHash();
+  // the duration of the current state
+  uint8_t stateDuration() const;
+  // end the current segment and begin the next one without waiting for it
+  void skipSegment();
+  // work out the ticks before the pattern repeats and the ticks per repeat
+  void computePeriod(uint32_t &start, uint32_t &length) const;
+  // play the first tick of an initialized pattern without the timeline and
+  // compile the timeline of the plain pattern, nullptr if it can't compile
+  std::shared_ptr<const PatternTimeline> beginSimulation();
+  // step a pattern at the loop start of the timeline one loop at a time until
+  // the blend colors and colorset index repeat or maxLoops loops have passed,
+  // the state at the start of each loop is added to keys
+  bool findLoopCycle(const PatternTimeline &timeline, uint32_t maxLoops,
+    std::vector<uint64_t> &keys, uint32_t &cycleStart);
+  // play the given number of loops of a pattern at the start of its cycle and
+  // return the fewest ticks the led output of those loops repeats in
+  uint32_t outputPeriod(const PatternTimeline &timeline, uint32_t loops);
+  // the color the led shows for the segment that just began
+  RGBColor segmentColor();
+  // restore the state saved in a key by findLoopCycle
+  void setLoopKey(uint64_t key);
+
+  // the compiled timeline, shared by every copy of the same pattern
+  std::shared_ptr<const PatternTimeline> m_timeline;
+  // the segment being played and the tick it began on
+  uint32_t m_segment;
+  uint32_t m_segmentStart;
+  uint32_t m_segmentLength;
+  // whether the pattern is playing from the timeline
+  bool m_timelineSync;
+  // the crc of the pattern and whether it's still up to date
+  uint32_t m_hash;
+  bool m_hashValid;
+  // whether this is a copy being run to compile a timeline
+  bool m_simulating;
+
+  // whether timelines are enabled
+  static HELIOS_TLS bool m_enableTimeline;
+#endif
 };
 
 #endif
@@ -0,0 +1,269 @@
+#include "PatternBatch.h"
+
+#ifdef HELIOS_CLI
+
+#include <string.h>
+
+#include "PatternTimeline.h"
+#include "Pattern.h"
+#include "Led.h"
+
+// the segment index of a pattern that hasn't started yet
+#define SEGMENT_NONE UINT32_MAX
+
+// step each current channel towards it's target by up to the step, this
+// is Pattern::interpolate() without any branches so it vectorizes
+static void interpolate_channels(uint8_t *cur, const uint8_t *next, const uint8_t *step, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; ++i) {
+    int16_t diff = (int16_t)next[i] - (int16_t)cur[i];
+    uint8_t dist = (uint8_t)(diff < 0 ? -diff : diff);
+    uint8_t amount = (dist < step[i]) ? dist : step[i];
+    cur[i] = (uint8_t)((diff < 0) ? (cur[i] - amount) : (cur[i] + amount));
+  }
+}
+
+PatternBatch::PatternBatch() :
+  m_kinds(),
+  m_durations(),
+  m_tables(),
+  m_remaining(),
+  m_segment(),
+  m_tableOffset(),
+  m_numSegments(),
+  m_loopStart(),
+  m_blendSpeed(),
+  m_numColors(),
+  m_colorIndex(),
+  m_palette(),
+  m_curRed(),
+  m_curGreen(),
+  m_curBlue(),
+  m_nextRed(),
+  m_nextGreen(),
+  m_nextBlue(),
+  m_red(),
+  m_green(),
+  m_blue(),
+  m_events(),
+  m_blends(),
+  m_blendCur(),
+  m_blendNext(),
+  m_blendStep()
+{
+}
+
+uint32_t PatternBatch::add(const Pattern &pat)
+{
+  // the blend colors and colorset index that init() starts with
+  Pattern start(pat);
+  start.init();
+  uint32_t offset = 0;
+  uint32_t numSegments = 0;
+  uint32_t loopStart = 0;
+  if (start.m_state != Pattern::STATE_DISABLED && !findTable(start, offset, numSegments, loopStart)) {
+    return UINT32_MAX;
+  }
+  m_remaining.push_back(0);
+  m_segment.push_back(SEGMENT_NONE);
+  m_tableOffset.push_back(offset);
+  m_numSegments.push_back(numSegments);
+  m_loopStart.push_back(loopStart);
+  m_blendSpeed.push_back(start.m_args.blend_speed);
+  m_numColors.push_back(start.m_colorset.numColors());
+  m_colorIndex.push_back(start.m_colorset.curIndex());
+  for (uint8_t i = 0; i < NUM_COLOR_SLOTS; ++i) {
+    m_palette.push_back(start.m_colorset.get(i));
+  }
+  m_curRed.push_back(start.m_cur.red);
+  m_curGreen.push_back(start.m_cur.green);
+  m_curBlue.push_back(start.m_cur.blue);
+  m_nextRed.push_back(start.m_next.red);
+  m_nextGreen.push_back(start.m_next.green);
+  m_nextBlue.push_back(start.m_next.blue);
+  m_red.push_back(0);
+  m_green.push_back(0);
+  m_blue.push_back(0);
+  return size() - 1;
+}
+
+void PatternBatch::clear()
+{
+  m_remaining.clear();
+  m_segment.clear();
+  m_tableOffset.clear();
+  m_numSegments.clear();
+  m_loopStart.clear();
+  m_blendSpeed.clear();
+  m_numColors.clear();
+  m_colorIndex.clear();
+  m_palette.clear();
+  m_curRed.clear();
+  m_curGreen.clear();
+  m_curBlue.clear();
+  m_nextRed.clear();
+  m_nextGreen.clear();
+  m_nextBlue.clear();
+  m_red.clear();
+  m_green.clear();
+  m_blue.clear();
+}
+
+void PatternBatch::step()
+{
+  uint32_t count = size();
+  uint16_t *remaining = m_remaining.data();
+  // gather the patterns whose segment ends this tick, this is branchless so
+  // the loop costs the same no matter how many segments end
+  m_events.resize(count);
+  uint32_t *events = m_events.data();
+  uint32_t numEvents = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    events[numEvents] = i;
+    numEvents += (remaining[i] == 0);
+  }
+  // start the next segment of each of those
+  m_blends.clear();
+  for (uint32_t e = 0; e < numEvents; ++e) {
+    uint32_t i = events[e];
+    if (!m_numSegments[i]) {
+      // disabled patterns never turn the led on
+      remaining[i] = UINT16_MAX;
+      continue;
+    }
+    uint32_t segment = m_segment[i] + 1;
+    if (m_segment[i] == SEGMENT_NONE) {
+      segment = 0;
+    } else if (segment >= m_numSegments[i]) {
+      segment = m_loopStart[i];
+    }
+    m_segment[i] = segment;
+    uint32_t entry = m_tableOffset[i] + segment;
+    remaining[i] = m_durations[entry];
+    switch (m_kinds[entry]) {
+    case SEGMENT_ON:
+      if (m_blendSpeed[i]) {
+        // the blend step of all of these runs together below
+        m_blends.push_back(i);
+        break;
+      }
+      // fall through
+    case SEGMENT_DASH:
+      {
+        RGBColor col = nextColor(i);
+        m_red[i] = col.red;
+        m_green[i] = col.green;
+        m_blue[i] = col.blue;
+      }
+      break;
+    default:
+      m_red[i] = 0;
+      m_green[i] = 0;
+      m_blue[i] = 0;
+      break;
+    }
+  }
+  // blend the colors of every pattern that blinked on
+  uint32_t numBlends = (uint32_t)m_blends.size();
+  if (numBlends > 0) {
+    m_blendCur.resize(numBlends * 3);
+    m_blendNext.resize(numBlends * 3);
+    m_blendStep.resize(numBlends * 3);
+    uint8_t *cur = m_blendCur.data();
+    uint8_t *next = m_blendNext.data();
+    uint8_t *step = m_blendStep.data();
+    for (uint32_t b = 0; b < numBlends; ++b) {
+      uint32_t i = m_blends[b];
+      // once the target is reached move on to the next color of the set
+      if (m_curRed[i] == m_nextRed[i] && m_curGreen[i] == m_nextGreen[i] && m_curBlue[i] == m_nextBlue[i]) {
+        RGBColor col = nextColor(i);
+        m_nextRed[i] = col.red;
+        m_nextGreen[i] = col.green;
+        m_nextBlue[i] = col.blue;
+      }
+      cur[b] = m_curRed[i];
+      cur[numBlends + b] = m_curGreen[i];
+      cur[(numBlends * 2) + b] = m_curBlue[i];
+      next[b] = m_nextRed[i];
+      next[numBlends + b] = m_nextGreen[i];
+      next[(numBlends * 2) + b] = m_nextBlue[i];
+      step[b] = step[numBlends + b] = step[(numBlends * 2) + b] = m_blendSpeed[i];
+    }
+    interpolate_channels(cur, next, step, numBlends * 3);
+    for (uint32_t b = 0; b < numBlends; ++b) {
+      uint32_t i = m_blends[b];
+      m_red[i] = m_curRed[i] = cur[b];
+      m_green[i] = m_curGreen[i] = cur[numBlends + b];
+      m_blue[i] = m_curBlue[i] = cur[(numBlends * 2) + b];
+    }
+  }
+  // count down the current segment of every pattern
+  for (uint32_t i = 0; i < count; ++i) {
+    remaining[i]--;
+  }
+}
+
+RGBColor PatternBatch::color(uint32_t index) const
+{
+  return RGBColor(m_red[index], m_green[index], m_blue[index]);
+}
+
+bool PatternBatch::findTable(const Pattern &pat, uint32_t &offset, uint32_t &numSegments, uint32_t &loopStart)
+{
+  // the segments only depend on the args and the number of colors
+  PatternArgs args = pat.m_args;
+  args.blend_speed = 0;
+  uint8_t numColors = pat.m_colorset.numColors();
+  std::string key((const char *)&args, sizeof(args));
+  key.push_back((char)numColors);
+  std::map<std::string, Table>::const_iterator it = m_tables.find(key);
+  if (it != m_tables.end()) {
+    offset = it->second.offset;
+    numSegments = it->second.numSegments;
+    loopStart = it->second.loopStart;
+    return true;
+  }
+  // compile the timeline of the plain pattern from it's first tick, running
+  // the copy sets the led so put that back afterwards
+  RGBColor led = Led::get();
+  Pattern sim(pat);
+  sim.m_timeline.reset();
+  sim.init();
+  std::shared_ptr<const PatternTimeline> timeline = sim.beginSimulation();
+  Led::set(led);
+  if (!timeline) {
+    return false;
+  }
+  Table table;
+  table.offset = (uint32_t)m_kinds.size();
+  table.numSegments = timeline->numSegments();
+  table.loopStart = timeline->loopStart();
+  for (uint32_t i = 0; i < timeline->numSegments(); ++i) {
+    const PatternTimeline::Segment &seg = timeline->segment(i);
+    uint8_t kind = SEGMENT_OFF;
+    if (seg.state == Pattern::STATE_ON) {
+      kind = SEGMENT_ON;
+    } else if (seg.state == Pattern::STATE_IN_DASH) {
+      kind = SEGMENT_DASH;
+    }
+    m_kinds.push_back(kind);
+    m_durations.push_back(seg.duration);
+  }
+  m_tables[key] = table;
+  offset = table.offset;
+  numSegments = table.numSegments;
+  loopStart = table.loopStart;
+  return true;
+}
+
+RGBColor PatternBatch::nextColor(uint32_t index)
+{
+  if (!m_numColors[index]) {
+    return RGB_OFF;
+  }
+  // the index starts at 255 so the first color is 0
+  m_colorIndex[index] = (uint8_t)(m_colorIndex[index] + 1) % m_numColors[index];
+  return m_palette[(index * NUM_COLOR_SLOTS) + m_colorIndex[index]];
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef PATTERN_BATCH_H
+#define PATTERN_BATCH_H
+
+#include <inttypes.h>
+
+#include "HeliosConfig.h"
+
+#ifdef HELIOS_CLI
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Colortypes.h"
+
+class Pattern;
+
+// Plays many patterns in lockstep for bulk previews and analysis.
+//
+// Every Pattern carries it's own args, colorset, timer and blend state and
+// play() branches it's way through the state machine each tick, so looping
+// over thousands of them is mostly spent on branches and pointer chasing.
+// The batch keeps the state of every pattern in flat arrays instead, one
+// array per field, and splits each tick into a few simple loops over those
+// arrays that the compiler can vectorize:
+//
+//  - count down the ticks left in the current segment of every pattern
+//  - gather the patterns whose segment ended
+//  - start the next segment of those, which is rare compared to the countdown
+//  - step the blend colors of the ones that blink on, all channels at once
+//
+// The segments come from the timeline of each pattern (see PatternTimeline)
+// which only depends on the args and number of colors, so patterns that only
+// differ by color share one segment table. Blends run the same segments and
+// only pick their colors differently so they are played on the same tables.
+class PatternBatch
+{
+public:
+  PatternBatch();
+
+  // add a pattern to the batch, it begins from init() on the next step(),
+  // returns the index of the pattern in the batch or UINT32_MAX if the
+  // pattern is too long to compile into a segment table
+  uint32_t add(const Pattern &pat);
+  // remove every pattern
+  void clear();
+
+  // play one tick of every pattern in the batch
+  void step();
+
+  uint32_t size() const { return (uint32_t)m_remaining.size(); }
+
+  // the led color each pattern showed on the last step
+  RGBColor color(uint32_t index) const;
+  const uint8_t *red() const { return m_red.data(); }
+  const uint8_t *green() const { return m_green.data(); }
+  const uint8_t *blue() const { return m_blue.data(); }
+
+private:
+  // what the led does at the start of a segment
+  enum SegmentKind : uint8_t
+  {
+    SEGMENT_OFF,
+    SEGMENT_ON,
+    SEGMENT_DASH,
+  };
+
+  // find or build the segment table of an initialized pattern, returns
+  // false if the pattern is too long to compile into a table
+  bool findTable(const Pattern &pat, uint32_t &offset, uint32_t &numSegments, uint32_t &loopStart);
+  // the next color of the colorset of a pattern, like Colorset::getNext()
+  RGBColor nextColor(uint32_t index);
+
+  // the segment tables of every pattern end to end
+  std::vector<uint8_t> m_kinds;
+  std::vector<uint8_t> m_durations;
+  // the offset, length and loop start of the table for each set of args
+  struct Table
+  {
+    uint32_t offset;
+    uint32_t numSegments;
+    uint32_t loopStart;
+  };
+  std::map<std::string, Table> m_tables;
+
+  // the state of every pattern, one entry per pattern in each array
+  std::vector<uint16_t> m_remaining;
+  std::vector<uint32_t> m_segment;
+  std::vector<uint32_t> m_tableOffset;
+  std::vector<uint32_t> m_numSegments;
+  std::vector<uint32_t> m_loopStart;
+  std::vector<uint8_t> m_blendSpeed;
+  std::vector<uint8_t> m_numColors;
+  std::vector<uint8_t> m_colorIndex;
+  // NUM_COLOR_SLOTS colors per pattern
+  std::vector<RGBColor> m_palette;
+  // the current and target blend colors
+  std::vector<uint8_t> m_curRed;
+  std::vector<uint8_t> m_curGreen;
+  std::vector<uint8_t> m_curBlue;
+  std::vector<uint8_t> m_nextRed;
+  std::vector<uint8_t> m_nextGreen;
+  std::vector<uint8_t> m_nextBlue;
+  // the led color of every pattern
+  std::vector<uint8_t> m_red;
+  std::vector<uint8_t> m_green;
+  std::vector<uint8_t> m_blue;
+
+  // scratch space for each step, the patterns that start a segment and the
+  // blend channels of the ones that blink on laid out red, green then blue
+  std::vector<uint32_t> m_events;
+  std::vector<uint32_t> m_blends;
+  std::vector<uint8_t> m_blendCur;
+  std::vector<uint8_t> m_blendNext;
+  std::vector<uint8_t> m_blendStep;
+};
+
+#endif
+
+#endif
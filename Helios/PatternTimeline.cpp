@@ -0,0 +1,85 @@
+#include "PatternTimeline.h"
+
+#ifdef HELIOS_CLI
+
+#include <algorithm>
+#include <map>
+
+#include "Pattern.h"
+#include "Led.h"
+
+PatternTimeline::PatternTimeline(uint32_t hash) :
+  m_hash(hash),
+  m_loopStart(0),
+  m_segments(),
+  m_starts(1, 0)
+{
+}
+
+std::shared_ptr<const PatternTimeline> PatternTimeline::compile(const Pattern &pat)
+{
+  if (pat.isBlend() || pat.m_state == Pattern::STATE_DISABLED) {
+    return nullptr;
+  }
+  std::shared_ptr<PatternTimeline> timeline(new PatternTimeline(pat.crc32()));
+  // run the state machine of a copy so the real pattern isn't touched, the
+  // copy still sets the led so that has to be put back afterwards
+  Pattern sim(pat);
+  sim.m_timeline.reset();
+  sim.m_timelineSync = false;
+  sim.m_simulating = true;
+  RGBColor led = Led::get();
+  // the index of the first segment that begins with each pattern state
+  std::map<uint32_t, uint32_t> seen;
+  while (1) {
+    uint8_t curIndex = sim.m_colorset.curIndex();
+    uint32_t key = ((uint32_t)sim.m_state << 16) | ((uint32_t)sim.m_groupCounter << 8) | curIndex;
+    std::map<uint32_t, uint32_t>::const_iterator it = seen.find(key);
+    if (it != seen.end()) {
+      // the state machine came back around to a segment it already played
+      timeline->m_loopStart = it->second;
+      break;
+    }
+    if (timeline->m_segments.size() >= MAX_SEGMENTS || curIndex >= sim.m_colorset.numColors()) {
+      Led::set(led);
+      return nullptr;
+    }
+    seen[key] = (uint32_t)timeline->m_segments.size();
+    Segment seg;
+    seg.color = Led::get();
+    seg.state = sim.m_state;
+    seg.groupCounter = sim.m_groupCounter;
+    seg.curIndex = curIndex;
+    seg.duration = sim.stateDuration();
+    timeline->m_segments.push_back(seg);
+    timeline->m_starts.push_back(timeline->m_starts.back() + seg.duration);
+    sim.skipSegment();
+  }
+  Led::set(led);
+  return timeline;
+}
+
+uint32_t PatternTimeline::find(uint8_t state, uint8_t groupCounter, uint8_t curIndex) const
+{
+  for (uint32_t i = 0; i < m_segments.size(); ++i) {
+    const Segment &seg = m_segments[i];
+    if (seg.state == state && seg.groupCounter == groupCounter && seg.curIndex == curIndex) {
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+uint32_t PatternTimeline::findTick(uint32_t tick) const
+{
+  // the last start that isn't after the tick
+  return (uint32_t)(std::upper_bound(m_starts.begin(), m_starts.end() - 1, tick) - m_starts.begin()) - 1;
+}
+
+uint32_t PatternTimeline::next(uint32_t index) const
+{
+  index++;
+  return (index < m_segments.size()) ? index : m_loopStart;
+}
+
+#endif
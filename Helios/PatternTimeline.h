@@ -0,0 +1,92 @@
+#ifndef PATTERN_TIMELINE_H
+#define PATTERN_TIMELINE_H
+
+#include <inttypes.h>
+
+#include "HeliosConfig.h"
+
+#ifdef HELIOS_CLI
+
+#include <memory>
+#include <vector>
+
+#include "Colortypes.h"
+
+class Pattern;
+
+// The precompiled segment table of a pattern.
+//
+// Outside of blends a pattern is just a fixed loop of (color, duration)
+// segments, but Pattern::play() works that out again every tick by running
+// through it's state machine. The timeline runs the state machine once for
+// every segment until the loop repeats, then the pattern can walk the table
+// with a single compare per tick and only touch the table when a segment ends.
+//
+// Each segment also carries the state of the pattern at the start of the
+// segment so the player can keep the pattern exactly where the state machine
+// would have it, that way it can hand back to the state machine at any time.
+class PatternTimeline
+{
+public:
+  struct Segment
+  {
+    // the color the led is set to at the start of the segment
+    RGBColor color;
+    // the pattern state, group counter and colorset index during the segment
+    uint8_t state;
+    uint8_t groupCounter;
+    uint8_t curIndex;
+    // how many ticks the segment lasts
+    uint8_t duration;
+  };
+
+  // compile the timeline of a pattern that has just begun a segment, the
+  // first segment of the timeline is that segment. Blends never repeat in a
+  // way that fits a table so they can't be compiled, nor can any pattern that
+  // takes more than MAX_SEGMENTS to loop, either way this returns nullptr
+  static std::shared_ptr<const PatternTimeline> compile(const Pattern &pat);
+
+  // the crc of the pattern that was compiled
+  uint32_t hash() const { return m_hash; }
+
+  // find the segment that begins with the given pattern state, returns
+  // UINT32_MAX if the pattern never passes through that state
+  uint32_t find(uint8_t state, uint8_t groupCounter, uint8_t curIndex) const;
+
+  // the segment after a segment, this wraps around to the start of the loop
+  uint32_t next(uint32_t index) const;
+
+  const Segment &segment(uint32_t index) const { return m_segments[index]; }
+  uint32_t numSegments() const { return (uint32_t)m_segments.size(); }
+
+  // the segments before the loop start only play once, ie the first blink
+  // of a pattern that was compiled right after it was initialized
+  uint32_t loopStart() const { return m_loopStart; }
+
+  // the tick a segment begins on counting from the start of the first
+  // segment, the index can be numSegments() for the end of the last segment
+  uint32_t segmentStart(uint32_t index) const { return m_starts[index]; }
+  // find the segment that plays on a tick counting from the start of the
+  // first segment, the tick must be before the end of the last segment
+  uint32_t findTick(uint32_t tick) const;
+
+  // the ticks played once before the loop and the ticks in each loop
+  uint32_t leadTicks() const { return m_starts[m_loopStart]; }
+  uint32_t loopTicks() const { return m_starts[m_segments.size()] - m_starts[m_loopStart]; }
+
+  // the max number of segments a timeline can hold
+  static const uint32_t MAX_SEGMENTS = 8192;
+
+private:
+  PatternTimeline(uint32_t hash);
+
+  uint32_t m_hash;
+  uint32_t m_loopStart;
+  std::vector<Segment> m_segments;
+  // the start tick of every segment followed by the end of the last one
+  std::vector<uint32_t> m_starts;
+};
+
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 
 #ifdef HELIOS_EMBEDDED
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #endif
 
 #ifdef HELIOS_CLI
@@ -13,153 +14,462 @@
 #include <stdio.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TimeControl.h"
 #endif
 
+// where the newest records are
+HELIOS_TLS Storage::Layout Storage::m_layout;
+
+// the write queue
+HELIOS_TLS uint16_t Storage::m_queueAddr[STORAGE_QUEUE_SIZE];
+HELIOS_TLS uint8_t Storage::m_queueData[STORAGE_QUEUE_SIZE];
+HELIOS_TLS volatile uint8_t Storage::m_queueHead = 0;
+HELIOS_TLS volatile uint8_t Storage::m_queueTail = 0;
+HELIOS_TLS volatile uint8_t Storage::m_queueFill = 0;
+#ifdef HELIOS_EMBEDDED
+volatile uint8_t Storage::m_writeAttempts = 0;
+#endif
+
+#define STORAGE_QUEUE_MASK (STORAGE_QUEUE_SIZE - 1)
+
 #ifdef HELIOS_CLI
 // whether storage is enabled, default enabled
-bool Storage::m_enableStorage = true;
+HELIOS_TLS bool Storage::m_enableStorage = true;
+// in-memory storage image, when not set the storage file is used
+HELIOS_TLS uint8_t *Storage::m_storageImage = nullptr;
+// the storage file mapped into memory
+HELIOS_TLS uint8_t *Storage::m_storageFile = nullptr;
+HELIOS_TLS bool Storage::m_dirty = false;
+// storage counters
+HELIOS_TLS uint64_t Storage::m_numReads = 0;
+HELIOS_TLS uint64_t Storage::m_numWrites = 0;
+HELIOS_TLS uint64_t Storage::m_numFlushes = 0;
+// the eeprom write model
+HELIOS_TLS bool Storage::m_syncWrites = false;
+HELIOS_TLS uint64_t Storage::m_busyUntil = 0;
+HELIOS_TLS uint32_t Storage::m_stallTick = 0;
+HELIOS_TLS uint64_t Storage::m_tickStall = 0;
+HELIOS_TLS Storage::WriteStats Storage::m_writeStats = {};
+// the eeprom wear model
+HELIOS_TLS Storage::WearStats Storage::m_wearStats = {};
+// the bulk of the models
+HELIOS_TLS Storage::Model Storage::m_threadModel;
+HELIOS_TLS Storage::Model *Storage::m_model = nullptr;
 #endif
 
 bool Storage::init()
 {
 #ifdef HELIOS_CLI
-  if (!m_enableStorage) {
-    return true;
-  }
-  // if the storage filename doesn't exist then create it
-  if (access(STORAGE_FILENAME, O_RDWR) != 0 && errno == ENOENT) {
-    // The file doesn't exist, so try creating it
-    FILE *f = fopen(STORAGE_FILENAME, "w+b");
-    if (!f) {
-      perror("Error creating storage file for write");
-      return false;
-    }
-    // fill the storage with 0s
-    for (uint32_t i = 0; i < STORAGE_SIZE; ++i){
-      uint8_t b = 0x0;
-      fwrite(&b, 1, sizeof(uint8_t), f);
-    }
-    fclose(f);
+  if (m_enableStorage && !m_storageImage && !map_file()) {
+    return false;
   }
 #endif
+  load_layout();
   return true;
 }
 
+void Storage::commit()
+{
+#ifdef HELIOS_CLI
+  if (!m_storageFile || !m_dirty) {
+    return;
+  }
+  if (msync(m_storageFile, STORAGE_SIZE, MS_SYNC) != 0) {
+    perror("Error flushing storage file");
+    return;
+  }
+  m_dirty = false;
+  m_numFlushes++;
+#endif
+}
+
+void Storage::flush()
+{
+#ifdef HELIOS_EMBEDDED
+  // the eeprom ready interrupt empties the queue, the last byte leaves the
+  // queue once it's written
+  while (m_queueTail != m_queueHead) {
+    // wait for the eeprom
+  }
+#else // HELIOS_CLI
+  if (!m_enableStorage) {
+    return;
+  }
+  // the device waits for the queue to empty
+  sim_stall(m_busyUntil);
+  sim_drain();
+  // the clock starts over when the device wakes up
+  m_busyUntil = 0;
+  commit();
+#endif
+}
+
 bool Storage::read_pattern(uint8_t slot, Pattern &pat)
 {
-  uint8_t pos = slot * SLOT_SIZE;
-  if (!check_crc(pos)) {
+  uint8_t pos = m_layout.slotRecord[slot];
+  if (pos >= NUM_SLOT_RECORDS) {
+    return false;
+  }
+  uint8_t record[SLOT_SIZE];
+  if (!read_record(SLOT_LOG_START + (pos * SLOT_SIZE), record, SLOT_SIZE)) {
     return false;
   }
   for (uint8_t i = 0; i < PATTERN_SIZE; ++i) {
-    ((uint8_t *)&pat)[i] = read_byte(pos + i);
+    ((uint8_t *)&pat)[i] = record[SLOT_PATTERN_OFFSET + i];
   }
   return true;
 }
 
 void Storage::write_pattern(uint8_t slot, const Pattern &pat)
 {
-  uint8_t pos = slot * SLOT_SIZE;
-  for (uint8_t i = 0; i < PATTERN_SIZE; ++i) {
-    uint8_t val = ((uint8_t *)&pat)[i];
-    uint8_t target = pos + i;
-    write_byte(target, val);
-  }
-  write_crc(pos);
+  write_slot(slot, (const uint8_t *)&pat);
 }
 
 void Storage::copy_slot(uint8_t srcSlot, uint8_t dstSlot)
 {
-  uint8_t src = srcSlot * SLOT_SIZE;
-  uint8_t dst = dstSlot * SLOT_SIZE;
-  for (uint8_t i = 0; i < SLOT_SIZE; ++i) {
-    write_byte(dst + i, read_byte(src + i));
+  uint8_t pos = m_layout.slotRecord[srcSlot];
+  if (pos >= NUM_SLOT_RECORDS) {
+    return;
+  }
+  // read the whole slot before queueing any writes so the reads don't have
+  // to wait for the eeprom to finish writing
+  uint8_t record[SLOT_SIZE];
+  if (!read_record(SLOT_LOG_START + (pos * SLOT_SIZE), record, SLOT_SIZE)) {
+    return;
   }
+  write_slot(dstSlot, record + SLOT_PATTERN_OFFSET);
 }
 
 uint8_t Storage::read_config(uint8_t index)
 {
-  return read_byte(CONFIG_START_INDEX - index);
+  return m_layout.config[index];
 }
 
 void Storage::write_config(uint8_t index, uint8_t val)
 {
-  write_byte(CONFIG_START_INDEX - index, val);
+  // only write a new record when something changed
+  if (m_layout.config[index] == val) {
+    return;
+  }
+  m_layout.config[index] = val;
+  m_layout.configRecord = (m_layout.configRecord + 1) % NUM_CONFIG_RECORDS;
+  m_layout.configSeq++;
+  uint8_t record[CONFIG_RECORD_SIZE];
+  record[0] = m_layout.configSeq;
+  for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+    record[1 + i] = m_layout.config[i];
+  }
+  write_record(m_layout.configRecord * CONFIG_RECORD_SIZE, record, CONFIG_RECORD_SIZE);
+#ifdef HELIOS_CLI
+  if (m_enableStorage) {
+    m_wearStats.numConfigRecords++;
+    wear_fixed(FIXED_CONFIG_START - index, val);
+  }
+#endif
 }
 
-uint8_t Storage::crc8(uint8_t pos, uint8_t size)
+uint8_t Storage::crc8(const uint8_t *data, uint8_t size)
 {
   uint8_t hash = 33;  // A non-zero initial value
   for (uint8_t i = 0; i < size; ++i) {
-    hash = ((hash << 5) + hash) + read_byte(pos);
+    hash = ((hash << 5) + hash) + data[i];
   }
   return hash;
 }
 
-uint8_t Storage::crc_pos(uint8_t pos)
+void Storage::load_layout()
+{
+  static_assert(SLOT_LOG_START + (NUM_SLOT_RECORDS * SLOT_SIZE) <= LAYOUT_MAGIC_INDEX,
+      "the slot log must end before the layout marker");
+  static_assert(FIXED_SLOT_RECORD + NUM_MODE_SLOTS <= NUM_SLOT_RECORDS,
+      "the old slots must fit in the log past the old layout");
+  m_layout.nextSlotRecord = 0;
+  if (read_byte(LAYOUT_MAGIC_INDEX) == LAYOUT_MAGIC && read_byte(LAYOUT_VERSION_INDEX) == LAYOUT_VERSION) {
+    find_records();
+  } else {
+    migrate_layout();
+  }
+#ifdef HELIOS_CLI
+  load_fixed();
+#endif
+}
+
+void Storage::find_records()
 {
-  // crc the entire slot except last byte
-  return crc8(pos, PATTERN_SIZE);
+  // the newest config record wins, the sequence numbers of the ring are all
+  // within a lap of each other so the difference of two tells which is newer
+  m_layout.configRecord = NUM_CONFIG_RECORDS - 1;
+  m_layout.configSeq = 0xFF;
+  for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+    m_layout.config[i] = 0;
+  }
+  bool found = false;
+  uint8_t record[SLOT_SIZE];
+  for (uint8_t pos = 0; pos < NUM_CONFIG_RECORDS; ++pos) {
+    if (!read_record(pos * CONFIG_RECORD_SIZE, record, CONFIG_RECORD_SIZE)) {
+      continue;
+    }
+    if (found && (int8_t)(record[0] - m_layout.configSeq) <= 0) {
+      continue;
+    }
+    found = true;
+    m_layout.configRecord = pos;
+    m_layout.configSeq = record[0];
+    for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+      m_layout.config[i] = record[1 + i];
+    }
+  }
+  // and the newest record of each slot, a slot's older records are written
+  // over within a lap of the log so the same goes for them
+  uint8_t slotSeq[NUM_MODE_SLOTS];
+  for (uint8_t slot = 0; slot < NUM_MODE_SLOTS; ++slot) {
+    m_layout.slotRecord[slot] = NUM_SLOT_RECORDS;
+    slotSeq[slot] = 0;
+  }
+  for (uint8_t pos = 0; pos < NUM_SLOT_RECORDS; ++pos) {
+    if (!read_record(SLOT_LOG_START + (pos * SLOT_SIZE), record, SLOT_SIZE)) {
+      continue;
+    }
+    uint8_t slot = record[0];
+    if (slot >= NUM_MODE_SLOTS) {
+      continue;
+    }
+    if (m_layout.slotRecord[slot] < NUM_SLOT_RECORDS && (int8_t)(record[1] - slotSeq[slot]) <= 0) {
+      continue;
+    }
+    m_layout.slotRecord[slot] = pos;
+    slotSeq[slot] = record[1];
+  }
 }
 
-uint8_t Storage::read_crc(uint8_t pos)
+void Storage::migrate_layout()
 {
-  // read the last byte of the slot
-  return read_byte(pos + PATTERN_SIZE);
+  // a blank eeprom looks the same as the old layout with nothing saved
+  bool found = false;
+  uint8_t record[SLOT_SIZE];
+  uint8_t *pattern = record + SLOT_PATTERN_OFFSET;
+  for (uint8_t slot = 0; slot < NUM_MODE_SLOTS; ++slot) {
+    uint8_t fixed = slot * FIXED_SLOT_SIZE;
+    for (uint8_t i = 0; i < PATTERN_SIZE; ++i) {
+      pattern[i] = read_byte(fixed + i);
+    }
+    // the old crc only ever hashed the first byte of the pattern
+    uint8_t crc = 33;
+    for (uint8_t i = 0; i < PATTERN_SIZE; ++i) {
+      crc = ((crc << 5) + crc) + pattern[0];
+    }
+    uint8_t pos = FIXED_SLOT_RECORD + slot;
+    uint16_t address = SLOT_LOG_START + (pos * SLOT_SIZE);
+    m_layout.slotRecord[slot] = NUM_SLOT_RECORDS;
+    if (crc == read_byte(fixed + PATTERN_SIZE)) {
+      record[0] = slot;
+      record[1] = 0;
+      write_record(address, record, SLOT_SIZE);
+    } else if (!read_record(address, record, SLOT_SIZE) || record[0] != slot) {
+      // unless a migration that got cut short already moved it
+      continue;
+    }
+    m_layout.slotRecord[slot] = pos;
+    found = true;
+  }
+  // the config bytes are only kept if there were saves to go with them,
+  // they have to be read before the config ring is cleared below
+  m_layout.configRecord = NUM_CONFIG_RECORDS - 1;
+  m_layout.configSeq = 0xFF;
+  for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+    m_layout.config[i] = found ? read_byte(FIXED_CONFIG_START - i) : 0;
+  }
+  // whatever else passes it's crc would be taken for a record, so those
+  // get their crc broken
+  for (uint8_t pos = 0; pos < NUM_CONFIG_RECORDS; ++pos) {
+    uint16_t address = pos * CONFIG_RECORD_SIZE;
+    if (read_record(address, record, CONFIG_RECORD_SIZE)) {
+      write_byte(address + CONFIG_RECORD_SIZE - 1, record[CONFIG_RECORD_SIZE - 1] + 1);
+    }
+  }
+  for (uint8_t pos = 0; pos < NUM_SLOT_RECORDS; ++pos) {
+    if (pos >= FIXED_SLOT_RECORD && pos < FIXED_SLOT_RECORD + NUM_MODE_SLOTS &&
+        m_layout.slotRecord[pos - FIXED_SLOT_RECORD] == pos) {
+      continue;
+    }
+    uint16_t address = SLOT_LOG_START + (pos * SLOT_SIZE);
+    if (read_record(address, record, SLOT_SIZE)) {
+      write_byte(address + SLOT_SIZE - 1, record[SLOT_SIZE - 1] + 1);
+    }
+  }
+  if (found) {
+    m_layout.configRecord = 0;
+    m_layout.configSeq = 0;
+    record[0] = 0;
+    for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+      record[1 + i] = m_layout.config[i];
+    }
+    write_record(0, record, CONFIG_RECORD_SIZE);
+  }
+  // the marker goes last so a migration that gets cut short runs again
+  write_byte(LAYOUT_MAGIC_INDEX, LAYOUT_MAGIC);
+  write_byte(LAYOUT_VERSION_INDEX, LAYOUT_VERSION);
 }
 
-bool Storage::check_crc(uint8_t pos)
+bool Storage::read_record(uint16_t address, uint8_t *record, uint8_t size)
 {
+  for (uint8_t i = 0; i < size; ++i) {
+    record[i] = read_byte(address + i);
+  }
   // compare the last byte to the calculated crc
-  return (read_crc(pos) == crc_pos(pos));
+  return record[size - 1] == crc8(record, size - 1);
 }
 
-void Storage::write_crc(uint8_t pos)
+void Storage::write_record(uint16_t address, uint8_t *record, uint8_t size)
 {
-  // compare the last byte to the calculated crc
-  write_byte(pos + PATTERN_SIZE, crc_pos(pos));
+  // the crc goes last so the record is only valid once all of it is written
+  record[size - 1] = crc8(record, size - 1);
+  for (uint8_t i = 0; i < size; ++i) {
+    write_byte(address + i, record[i]);
+  }
+}
+
+void Storage::write_slot(uint8_t slot, const uint8_t *pattern)
+{
+  // the next record in the log that isn't the newest record of a slot,
+  // including this one so it's still there if the save gets cut short
+  uint8_t pos = m_layout.nextSlotRecord;
+  uint8_t i = 0;
+  while (i < NUM_MODE_SLOTS) {
+    if (m_layout.slotRecord[i] == pos) {
+      pos = (pos + 1) % NUM_SLOT_RECORDS;
+      i = 0;
+      continue;
+    }
+    i++;
+  }
+  uint8_t record[SLOT_SIZE];
+  record[0] = slot;
+  record[1] = 0;
+  if (m_layout.slotRecord[slot] < NUM_SLOT_RECORDS) {
+    // one past the sequence of the record it replaces
+    record[1] = read_byte(SLOT_LOG_START + (m_layout.slotRecord[slot] * SLOT_SIZE) + 1) + 1;
+  }
+  for (i = 0; i < PATTERN_SIZE; ++i) {
+    record[SLOT_PATTERN_OFFSET + i] = pattern[i];
+  }
+  write_record(SLOT_LOG_START + (pos * SLOT_SIZE), record, SLOT_SIZE);
+  m_layout.slotRecord[slot] = pos;
+  m_layout.nextSlotRecord = (pos + 1) % NUM_SLOT_RECORDS;
+#ifdef HELIOS_CLI
+  if (m_enableStorage) {
+    m_wearStats.numSlotRecords++;
+    // the old layout saved the pattern and the crc of it in place
+    uint8_t fixed = slot * FIXED_SLOT_SIZE;
+    for (i = 0; i < PATTERN_SIZE; ++i) {
+      wear_fixed(fixed + i, pattern[i]);
+    }
+    wear_fixed(fixed + PATTERN_SIZE, crc8(pattern, PATTERN_SIZE));
+  }
+#endif
 }
 
-void Storage::write_byte(uint8_t address, uint8_t data)
+void Storage::write_byte(uint16_t address, uint8_t data)
 {
+  // the records go past the first 256 bytes so the queue has to carry
+  // all 16 bits of every address through to the eeprom
+  static_assert(sizeof(m_queueAddr[0]) == sizeof(uint16_t) && STORAGE_SIZE <= 0x10000,
+      "storage queue addresses must be 16-bit");
 #ifdef HELIOS_EMBEDDED
-  // reads out the byte of the eeprom first to see if it's different
-  // before writing out the byte -- this is faster than always writing
-  if (read_byte(address) == data) {
-    return;
+  // wait for room in the queue, this only happens when more than a queue
+  // full of bytes are saved at once
+  while (((m_queueHead + 1) & STORAGE_QUEUE_MASK) == m_queueTail) {
+    // wait for the eeprom
   }
-  internal_write(address, data);
-  // double check that shit
-  if (read_byte(address) != data) {
-    // do it again because eeprom is stupid
-    internal_write(address, data);
-    // god forbid it doesn't write again
+  uint8_t oldSREG = SREG;
+  cli();
+  m_queueAddr[m_queueHead] = address;
+  m_queueData[m_queueHead] = data;
+  m_queueHead = (m_queueHead + 1) & STORAGE_QUEUE_MASK;
+  if (m_queueFill < STORAGE_QUEUE_SIZE) {
+    m_queueFill++;
   }
+  // the eeprom ready interrupt fires for as long as it's enabled and the
+  // eeprom is idle, so this starts the queue going if it wasn't already
+  EECR |= (1 << EERIE);
+  SREG = oldSREG;
 #else // HELIOS_CLI
   if (!m_enableStorage) {
     return;
   }
-  FILE *f = fopen(STORAGE_FILENAME, "r+b");
-  if (!f) {
-    perror("Error opening storage file");
-    return;
+  m_numWrites++;
+  uint8_t *storage = m_storageImage;
+  if (!storage) {
+    if (!map_file()) {
+      return;
+    }
+    storage = m_storageFile;
+    m_dirty = true;
   }
-  // Seek to the specified address
-  if (fseek(f, address, SEEK_SET) != 0) {
-    perror("Error opening storage file for write");
-    fclose(f);
-    return;
+  // the storage takes the byte right away, only the time is modelled
+  bool changed = (storage[address] != data);
+  sim_write(address, data, changed);
+  storage[address] = data;
+  uint32_t &writeCount = model().writeCounts[address];
+  if (changed && ++writeCount > m_wearStats.maxWrites) {
+    m_wearStats.maxWrites = writeCount;
   }
-  if (!fwrite((const void *)&data, sizeof(uint8_t), 1, f)) {
-    return;
+#endif
+}
+
+uint8_t Storage::read_byte(uint16_t address)
+{
+#ifdef HELIOS_EMBEDDED
+  uint8_t data;
+  if (read_queue(address, data)) {
+    return data;
+  }
+  return read_eeprom(address);
+#else
+  if (!m_enableStorage) {
+    return 0;
+  }
+  m_numReads++;
+  sim_read(address);
+  if (m_storageImage) {
+    return m_storageImage[address];
   }
-  fclose(f); // Close the file
+  if (!map_file()) {
+    return 0;
+  }
+  return m_storageFile[address];
 #endif
 }
 
-uint8_t Storage::read_byte(uint8_t address)
+bool Storage::read_queue(uint16_t address, uint8_t &data)
 {
+  bool found = false;
 #ifdef HELIOS_EMBEDDED
+  uint8_t oldSREG = SREG;
+  cli();
+#endif
+  // the newest write of the byte is the one that counts
+  uint8_t index = m_queueHead;
+  for (uint8_t i = 0; i < m_queueFill; ++i) {
+    index = (index - 1) & STORAGE_QUEUE_MASK;
+    if (m_queueAddr[index] == address) {
+      data = m_queueData[index];
+      found = true;
+      break;
+    }
+  }
+#ifdef HELIOS_EMBEDDED
+  SREG = oldSREG;
+#endif
+  return found;
+}
+
+#ifdef HELIOS_EMBEDDED
+uint8_t Storage::read_eeprom(uint16_t address)
+{
   // do a three way read because the attiny85 eeprom basically doesn't work
   uint8_t b1 = internal_read(address);
   uint8_t b2 = internal_read(address);
@@ -174,44 +484,77 @@ uint8_t Storage::read_byte(uint8_t address)
     return b2;
   }
   return 0;
-#else
-  if (!m_enableStorage) {
-    return 0;
+}
+
+void Storage::write_next()
+{
+  while (m_queueTail != m_queueHead) {
+    uint16_t address = m_queueAddr[m_queueTail];
+    uint8_t data = m_queueData[m_queueTail];
+    // reads out the byte of the eeprom first to see if it's different
+    // before writing out the byte -- this is faster than always writing,
+    // and it double checks the write that just finished
+    uint8_t current = read_eeprom(address);
+    if (current != data && m_writeAttempts < 2) {
+      // do it again because eeprom is stupid
+      m_writeAttempts++;
+      internal_write(address, data);
+      return;
+    }
+    // god forbid it doesn't write again, keep what the eeprom actually
+    // holds so reads of the byte match it
+    m_queueData[m_queueTail] = current;
+    m_writeAttempts = 0;
+    m_queueTail = (m_queueTail + 1) & STORAGE_QUEUE_MASK;
   }
-  uint8_t val = 0;
-  if (access(STORAGE_FILENAME, O_RDONLY) != 0) {
-    return val;
+  // the eeprom is idle so reads can go straight to it again
+  m_queueFill = 0;
+  EECR &= ~(1 << EERIE);
+}
+
+ISR(EE_RDY_vect) {
+  Storage::write_next();
+}
+#endif
+
+#ifdef HELIOS_CLI
+bool Storage::map_file()
+{
+  if (m_storageFile) {
+    return true;
   }
-  FILE *f = fopen(STORAGE_FILENAME, "rb"); // Open file for reading in binary mode
-  if (!f) {
-		// this error is ok, just means no storage
-    //perror("Error opening file for read");
-    return val;
+  // open the storage file or create it if it doesn't exist
+  int fd = open(STORAGE_FILENAME, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror("Error opening storage file");
+    return false;
   }
-  // Seek to the specified address
-  if (fseek(f, address, SEEK_SET) != 0) {
-    // error
-    perror("Failed to seek");
-    fclose(f);
-    return val;
+  // a new or short file is filled out with 0s to the full storage size
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (st.st_size < STORAGE_SIZE && ftruncate(fd, STORAGE_SIZE) != 0)) {
+    perror("Error sizing storage file");
+    close(fd);
+    return false;
   }
-  // Read a byte of data
-  if (!fread(&val, sizeof(uint8_t), 1, f)) {
-    perror("Failed to read byte");
+  void *map = mmap(nullptr, STORAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // the mapping holds it's own reference to the file
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("Error mapping storage file");
+    return false;
   }
-  fclose(f); // Close the file
-  return val;
-#endif
+  m_storageFile = (uint8_t *)map;
+  return true;
 }
+#endif
 
 #ifdef HELIOS_EMBEDDED
-inline void Storage::internal_write(uint8_t address, uint8_t data)
+inline void Storage::internal_write(uint16_t address, uint8_t data)
 {
-  while (EECR & (1<<EEPE)) {
-    // Wait for completion of previous write
-  }
-  // Set Programming mode
-  EECR = (0<<EEPM1)|(0<<EEPM0);
+  // only called by the eeprom ready interrupt so the eeprom is idle
+  // Set Programming mode, only the mode bits are cleared because the ready
+  // interrupt has to stay enabled to start the next write in the queue
+  EECR &= ~((1<<EEPM1)|(1<<EEPM0));
   // Set up address and data registers
   EEAR = address;
   EEDR = data;
@@ -221,8 +564,15 @@ inline void Storage::internal_write(uint8_t address, uint8_t data)
   EECR |= (1<<EEPE);
 }
 
-inline uint8_t Storage::internal_read(uint8_t address)
+inline uint8_t Storage::internal_read(uint16_t address)
 {
+  // hold the write queue while the read waits, otherwise the eeprom ready
+  // interrupt would start the next write as soon as this one is done
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t queued = EECR & (1<<EERIE);
+  EECR &= ~(1<<EERIE);
+  SREG = oldSREG;
   while (EECR & (1<<EEPE)) {
     // Wait for completion of previous write
   }
@@ -230,7 +580,166 @@ inline uint8_t Storage::internal_read(uint8_t address)
   EEAR = address;
   // Start eeprom read by writing EERE
   EECR |= (1<<EERE);
-  // Return data from data register
-  return EEDR;
+  // Read data from data register
+  uint8_t data = EEDR;
+  // let the queue carry on
+  EECR |= queued;
+  return data;
+}
+#endif
+
+#ifdef HELIOS_CLI
+uint64_t Storage::sim_now()
+{
+  // the start of the current tick plus however long the device has already
+  // waited on the eeprom during it
+  uint32_t tick = Time::getCurtime();
+  if (tick != m_stallTick) {
+    m_stallTick = tick;
+    m_tickStall = 0;
+  }
+  return ((uint64_t)tick * (1000000 / TICKRATE)) + m_tickStall;
+}
+
+void Storage::sim_stall(uint64_t until)
+{
+  uint64_t now = sim_now();
+  if (until <= now) {
+    return;
+  }
+  const uint64_t tickLength = 1000000 / TICKRATE;
+  // the tick is late the first time it waits longer than a tick
+  if (m_tickStall <= tickLength && m_tickStall + (until - now) > tickLength) {
+    m_writeStats.numLateTicks++;
+  }
+  m_tickStall += until - now;
+  m_writeStats.totalStall += until - now;
+  if (m_tickStall > m_writeStats.maxStall) {
+    m_writeStats.maxStall = m_tickStall;
+  }
+}
+
+void Storage::sim_drain()
+{
+  // the bytes that are done leave the queue
+  uint64_t now = sim_now();
+  const uint64_t *queueDone = model().queueDone;
+  while (m_queueTail != m_queueHead && queueDone[m_queueTail] <= now) {
+    m_queueTail = (m_queueTail + 1) & STORAGE_QUEUE_MASK;
+  }
+  if (m_queueTail == m_queueHead) {
+    m_queueFill = 0;
+  }
+}
+
+void Storage::sim_write(uint16_t address, uint8_t data, bool changed)
+{
+  if (changed) {
+    m_writeStats.numProgrammed++;
+  }
+  if (m_syncWrites) {
+    // each byte waited for the last write then for itself to be written
+    sim_stall(m_busyUntil);
+    if (changed) {
+      m_busyUntil = sim_now() + EEPROM_WRITE_US;
+      sim_stall(m_busyUntil);
+    }
+    return;
+  }
+  sim_drain();
+  // wait for room in the queue
+  if (((m_queueHead + 1) & STORAGE_QUEUE_MASK) == m_queueTail) {
+    sim_stall(model().queueDone[m_queueTail]);
+    sim_drain();
+  }
+  // unchanged bytes are checked and skipped as soon as the eeprom gets to them
+  uint64_t now = sim_now();
+  if (m_busyUntil < now) {
+    m_busyUntil = now;
+  }
+  if (changed) {
+    m_busyUntil += EEPROM_WRITE_US;
+  }
+  m_queueAddr[m_queueHead] = address;
+  m_queueData[m_queueHead] = data;
+  model().queueDone[m_queueHead] = m_busyUntil;
+  m_queueHead = (m_queueHead + 1) & STORAGE_QUEUE_MASK;
+  if (m_queueFill < STORAGE_QUEUE_SIZE) {
+    m_queueFill++;
+  }
+}
+
+void Storage::sim_read(uint16_t address)
+{
+  sim_drain();
+  uint8_t data;
+  // a read of a byte that isn't in the queue waits for the write in
+  // progress, which is the next one to finish before the queue is done
+  uint64_t now = sim_now();
+  if (m_busyUntil > now && !read_queue(address, data)) {
+    sim_stall(now + ((m_busyUntil - now - 1) % EEPROM_WRITE_US) + 1);
+  }
+}
+#endif
+
+#ifdef HELIOS_CLI
+uint8_t *Storage::image()
+{
+  if (!m_enableStorage) {
+    return nullptr;
+  }
+  return m_storageImage ? m_storageImage : m_storageFile;
+}
+
+void Storage::load_fixed()
+{
+  // the old layout starts out holding the same saves
+  uint8_t *storage = image();
+  if (!storage) {
+    return;
+  }
+  uint8_t *fixedImage = model().fixedImage;
+  for (uint8_t slot = 0; slot < NUM_MODE_SLOTS; ++slot) {
+    uint8_t pos = m_layout.slotRecord[slot];
+    if (pos >= NUM_SLOT_RECORDS) {
+      continue;
+    }
+    const uint8_t *pattern = storage + SLOT_LOG_START + (pos * SLOT_SIZE) + SLOT_PATTERN_OFFSET;
+    uint8_t fixed = slot * FIXED_SLOT_SIZE;
+    for (uint8_t i = 0; i < PATTERN_SIZE; ++i) {
+      fixedImage[fixed + i] = pattern[i];
+    }
+    fixedImage[fixed + PATTERN_SIZE] = crc8(pattern, PATTERN_SIZE);
+  }
+  for (uint8_t i = 0; i < NUM_CONFIG_BYTES; ++i) {
+    fixedImage[FIXED_CONFIG_START - i] = m_layout.config[i];
+  }
+}
+
+void Storage::wear_fixed(uint8_t address, uint8_t data)
+{
+  // the old layout only wrote the bytes that changed
+  Model &fixed = model();
+  if (fixed.fixedImage[address] == data) {
+    return;
+  }
+  fixed.fixedImage[address] = data;
+  if (++fixed.fixedWriteCounts[address] > m_wearStats.maxFixedWrites) {
+    m_wearStats.maxFixedWrites = fixed.fixedWriteCounts[address];
+  }
+}
+
+double Storage::enduranceGain()
+{
+  // once the ring and the log have gone around a few times each byte of a
+  // config record is written once a lap of the ring, and each byte of the
+  // spare slot records once a lap of the spares
+  double configRate = (double)m_wearStats.numConfigRecords / NUM_CONFIG_RECORDS;
+  double slotRate = (double)m_wearStats.numSlotRecords / (NUM_SLOT_RECORDS - NUM_MODE_SLOTS);
+  double rate = (configRate > slotRate) ? configRate : slotRate;
+  if (!rate) {
+    return 0;
+  }
+  return m_wearStats.maxFixedWrites / rate;
 }
 #endif
@@ -4,17 +4,59 @@
 #include <inttypes.h>
 #include "HeliosConfig.h"
 
-// the index of the first config byte, the config bytes start at the end
-// then work their way backwards (so 'config index 0' is the last byte)
-#define CONFIG_START_INDEX (STORAGE_SIZE - 2)
-// the crc of the config bytes is the very last byte in storage
-// TODO: implement the global config CRC again it got removed at some point
-#define CONFIG_CRC_INDEX (STORAGE_SIZE - 1)
-
-// Storage Config Indexes relative to the CONFIG_START_INDEX
+// The storage is wear leveled across the whole eeprom. Nothing is saved in
+// place, each save writes a whole new record with a sequence number and a
+// crc and at boot the newest valid record of each kind is used. A save that
+// gets cut short fails it's crc so the record before it is used instead.
+//
+// The config bytes are saved far more often than the modes so they have a
+// ring of records at the start of storage, each one is:
+//
+//   seq, global flags, current mode, brightness, crc
+//
+// Followed by the log of slot records, each one is:
+//
+//   slot, seq, pattern (PATTERN_SIZE bytes), crc
+//
+// A saved mode goes to the next record in the log that doesn't hold the
+// newest record of any slot, so the spare records rotate through the log.
+//
+// The last two bytes of storage mark the layout with a magic and version.
+// Storage without them is from the old layout that saved in place, at boot
+// it's saves are moved into records once and everything else is cleared.
+
+// Storage Config Indexes, the config bytes of a config record
 #define STORAGE_GLOBAL_FLAG_INDEX 0
 #define STORAGE_CURRENT_MODE_INDEX 1
 #define STORAGE_BRIGHTNESS_INDEX 2
+#define NUM_CONFIG_BYTES 3
+
+// the config ring, a record is the sequence, the config bytes and the crc
+#define CONFIG_RECORD_SIZE (NUM_CONFIG_BYTES + 2)
+#define NUM_CONFIG_RECORDS 26
+
+// the slot log starts after the config ring and fills the rest of storage,
+// it must have more records than there are slots
+#define SLOT_LOG_START (NUM_CONFIG_RECORDS * CONFIG_RECORD_SIZE)
+#define NUM_SLOT_RECORDS ((STORAGE_SIZE - SLOT_LOG_START) / SLOT_SIZE)
+// where the pattern is in a slot record
+#define SLOT_PATTERN_OFFSET 2
+
+// the layout marker goes after the end of the slot log
+#define LAYOUT_MAGIC_INDEX (STORAGE_SIZE - 2)
+#define LAYOUT_VERSION_INDEX (STORAGE_SIZE - 1)
+#define LAYOUT_MAGIC 0x48
+#define LAYOUT_VERSION 1
+
+// the old layout saved each slot in place one after the other from the
+// start of the lower half of the eeprom, with a crc after each pattern,
+// and the config bytes backwards from the end of it
+#define FIXED_STORAGE_SIZE 256
+#define FIXED_SLOT_SIZE (PATTERN_SIZE + 1)
+#define FIXED_CONFIG_START (FIXED_STORAGE_SIZE - 2)
+// the first record of the log past the old layout, the old slots are moved
+// to the records from here on so they don't write over the ones left to move
+#define FIXED_SLOT_RECORD ((FIXED_STORAGE_SIZE - SLOT_LOG_START + SLOT_SIZE - 1) / SLOT_SIZE)
 
 class Pattern;
 
@@ -41,29 +83,187 @@ public:
   static uint8_t read_brightness() { return read_config(STORAGE_BRIGHTNESS_INDEX); }
   static void write_brightness(uint8_t brightness) { write_config(STORAGE_BRIGHTNESS_INDEX, brightness); }
 
-  static uint8_t crc8(uint8_t pos, uint8_t size);
+  static uint8_t crc8(const uint8_t *data, uint8_t size);
+
+  // the device just saved, the bytes are still on their way to the eeprom
+  // but the CLI syncs the storage file to disk so the save survives a crash
+  static void commit();
+  // wait for everything written so far to reach the storage, this is done
+  // before the device goes to sleep
+  static void flush();
+
+#ifdef HELIOS_EMBEDDED
+  // write out the next byte in the write queue, called by the eeprom ready
+  // interrupt each time the eeprom finishes a write
+  static void write_next();
+#endif
 
 #ifdef HELIOS_CLI
+  // how long the device would have waited on the eeprom, the device writes
+  // each changed byte in EEPROM_WRITE_US while the simulation runs on
+  struct WriteStats
+  {
+    // the number of bytes the eeprom actually had to write
+    uint64_t numProgrammed;
+    // the total and the most time spent waiting in one tick in microseconds
+    uint64_t totalStall;
+    uint64_t maxStall;
+    // the number of ticks that waited longer than a tick
+    uint32_t numLateTicks;
+  };
+
+  // how hard the saves wore the eeprom, compared to the old layout that
+  // saved each slot and config byte in place in the lower half
+  struct WearStats
+  {
+    // the number of config and slot records written
+    uint64_t numConfigRecords;
+    uint64_t numSlotRecords;
+    // the most times any one byte was written with each layout
+    uint64_t maxWrites;
+    uint64_t maxFixedWrites;
+  };
+
   // toggle storage on/off
   static void enableStorage(bool enabled) { m_enableStorage = enabled; }
+  // back the storage with an in-memory image of STORAGE_SIZE bytes instead
+  // of the storage file, pass nullptr to go back to using the file
+  static void setStorageImage(uint8_t *image) { m_storageImage = image; }
+
+  // the number of bytes read and written and the number of flushes that
+  // actually had something to write out, these count for the whole thread
+  static uint64_t numReads() { return m_numReads; }
+  static uint64_t numWrites() { return m_numWrites; }
+  static uint64_t numFlushes() { return m_numFlushes; }
+
+  // model the old writes that waited for the eeprom on every byte instead
+  // of the write queue, to compare the two
+  static void enableSyncWrites(bool enabled) { m_syncWrites = enabled; }
+  static const WriteStats &writeStats() { return m_writeStats; }
+  static const WearStats &wearStats() { return m_wearStats; }
+  // how many times longer the eeprom should last than with the old layout
+  // if the saves keep going like they have, this assumes the spare slot
+  // records take turns and the slots that are never saved stay put
+  static double enduranceGain();
 #endif
 private:
-  static uint8_t crc_pos(uint8_t pos);
-  static uint8_t read_crc(uint8_t pos);
-  static bool check_crc(uint8_t pos);
-  static void write_crc(uint8_t pos);
+  // where the newest records are, found at boot and kept up to date
+  struct Layout
+  {
+    // the newest record of each slot in the log, NUM_SLOT_RECORDS if none
+    uint8_t slotRecord[NUM_MODE_SLOTS];
+    // the next record in the log to try saving a slot to
+    uint8_t nextSlotRecord;
+    // the newest config record, it's sequence and config bytes
+    uint8_t configRecord;
+    uint8_t configSeq;
+    uint8_t config[NUM_CONFIG_BYTES];
+  };
+
+  // find the newest records, or move the saves of the old layout to them
+  static void load_layout();
+  static void find_records();
+  static void migrate_layout();
+  // read a record into the buffer, returns false if it fails it's crc
+  static bool read_record(uint16_t address, uint8_t *record, uint8_t size);
+  // write a record, the last byte of it is filled in with the crc
+  static void write_record(uint16_t address, uint8_t *record, uint8_t size);
+  // save a pattern to a new record of the slot
+  static void write_slot(uint8_t slot, const uint8_t *pattern);
+
+  static void write_byte(uint16_t address, uint8_t data);
+  static uint8_t read_byte(uint16_t address);
 
-  static void write_byte(uint8_t address, uint8_t data);
-  static uint8_t read_byte(uint8_t address);
+  // find a byte in the write queue that hasn't reached the eeprom yet, or
+  // was written since the eeprom was last idle
+  static bool read_queue(uint16_t address, uint8_t &data);
 
 #ifdef HELIOS_EMBEDDED
-  static inline uint8_t internal_read(uint8_t address);
-  static inline void internal_write(uint8_t address, uint8_t data);
+  static uint8_t read_eeprom(uint16_t address);
+  static inline uint8_t internal_read(uint16_t address);
+  static inline void internal_write(uint16_t address, uint8_t data);
+#endif
+
+  static HELIOS_TLS Layout m_layout;
+
+  // the bytes waiting to be written, the queue runs from the tail to the
+  // head and the last fill entries before the head are kept until the
+  // eeprom is idle so they can be read while the eeprom is busy
+  static HELIOS_TLS uint16_t m_queueAddr[STORAGE_QUEUE_SIZE];
+  static HELIOS_TLS uint8_t m_queueData[STORAGE_QUEUE_SIZE];
+  static HELIOS_TLS volatile uint8_t m_queueHead;
+  static HELIOS_TLS volatile uint8_t m_queueTail;
+  static HELIOS_TLS volatile uint8_t m_queueFill;
+#ifdef HELIOS_EMBEDDED
+  // the number of times the byte at the tail has been written
+  static volatile uint8_t m_writeAttempts;
 #endif
 
 #ifdef HELIOS_CLI
+  // map the storage file into memory, only done the first time
+  static bool map_file();
+
+  // the model of the time the eeprom takes to write
+  static uint64_t sim_now();
+  static void sim_stall(uint64_t until);
+  static void sim_drain();
+  static void sim_write(uint16_t address, uint8_t data, bool changed);
+  static void sim_read(uint16_t address);
+
+  // the model of the wear of the eeprom
+  static uint8_t *image();
+  static void load_fixed();
+  static void wear_fixed(uint8_t address, uint8_t data);
+
+  // the engine context swaps these globals in and out for each device
+  friend class HeliosEngine;
+
   // whether storage is enabled
-  static bool m_enableStorage;
+  static HELIOS_TLS bool m_enableStorage;
+  // optional in-memory storage image used instead of the storage file
+  static HELIOS_TLS uint8_t *m_storageImage;
+
+  // the storage file mapped into memory, it's loaded once and shared with
+  // the file so writes show up there right away and a flush syncs it to disk
+  static HELIOS_TLS uint8_t *m_storageFile;
+  // whether the storage file has writes that haven't been flushed
+  static HELIOS_TLS bool m_dirty;
+
+  // the storage counters
+  static HELIOS_TLS uint64_t m_numReads;
+  static HELIOS_TLS uint64_t m_numWrites;
+  static HELIOS_TLS uint64_t m_numFlushes;
+
+  // the bulk of the eeprom models, these are held behind a pointer so an
+  // engine context can swap them in and out without copying them
+  struct Model
+  {
+    // when each byte in the queue is done being written, in simulated
+    // microseconds
+    uint64_t queueDone[STORAGE_QUEUE_SIZE];
+    // the number of times each byte was written, and the same for an image
+    // of the old layout that gets the same saves
+    uint32_t writeCounts[STORAGE_SIZE];
+    uint8_t fixedImage[FIXED_STORAGE_SIZE];
+    uint32_t fixedWriteCounts[FIXED_STORAGE_SIZE];
+  };
+  // the model in use, the one of the thread unless an engine is bound
+  static Model &model() { return m_model ? *m_model : m_threadModel; }
+
+  // whether the old blocking writes are modelled instead of the queue
+  static HELIOS_TLS bool m_syncWrites;
+  // when the eeprom is done with every byte in the queue
+  static HELIOS_TLS uint64_t m_busyUntil;
+  // the tick the device is waiting in and how long it has waited so far
+  static HELIOS_TLS uint32_t m_stallTick;
+  static HELIOS_TLS uint64_t m_tickStall;
+  static HELIOS_TLS WriteStats m_writeStats;
+
+  static HELIOS_TLS WearStats m_wearStats;
+
+  // the model of the thread and the model of the bound engine if any
+  static HELIOS_TLS Model m_threadModel;
+  static HELIOS_TLS Model *m_model;
 #endif
 };
 
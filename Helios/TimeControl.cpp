@@ -17,26 +17,40 @@
 #ifdef HELIOS_CLI
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
 uint64_t start = 0;
 // convert seconds and nanoseconds to microseconds
 #define SEC_TO_US(sec) ((sec)*1000000)
 #define NS_TO_US(ns) ((ns)/1000)
+// the length of a tick in nanoseconds
+#define TICK_NS (1000000000ull / TICKRATE)
+// if the timestep falls further behind than this (a stopped terminal or a
+// slow machine) it starts the schedule over instead of racing to catch up
+#define TIMESTEP_MAX_LAG_NS (100 * 1000000ull)
 #endif
 
 // static members
-uint32_t Time::m_curTick = 0;
+HELIOS_TLS uint32_t Time::m_curTick = 0;
 // the last frame timestamp
-uint32_t Time::m_prevTime = 0;
+HELIOS_TLS uint32_t Time::m_prevTime = 0;
 
 #ifdef HELIOS_CLI
 // whether timestep is enabled, default enabled
-bool Time::m_enableTimestep = true;
+HELIOS_TLS bool Time::m_enableTimestep = true;
+// whether the timestep spins instead of sleeping
+HELIOS_TLS bool Time::m_spinTimestep = false;
+// when the next tick is due, 0 until the first tick
+HELIOS_TLS uint64_t Time::m_tickDeadline = 0;
+HELIOS_TLS Time::TimestepStats Time::m_timestepStats = {0, 0, 0, 0, 0};
 #endif
 
 bool Time::init()
 {
   m_prevTime = microseconds();
   m_curTick = 0;
+#ifdef HELIOS_CLI
+  m_tickDeadline = 0;
+#endif
   return true;
 }
 
@@ -53,6 +67,10 @@ void Time::tickClock()
   if (!m_enableTimestep) {
     return;
   }
+  if (!m_spinTimestep) {
+    sleepTimestep();
+    return;
+  }
 #endif
 
   // the rest of this only runs inside vortexlib because on the duo the tick runs in the
@@ -81,6 +99,47 @@ void Time::tickClock()
   m_prevTime = microseconds();
 }
 
+#ifdef HELIOS_CLI
+// read the monotonic clock in nanoseconds
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+void Time::sleepTimestep()
+{
+  uint64_t now = monotonic_ns();
+  if (!m_tickDeadline || now > m_tickDeadline + TIMESTEP_MAX_LAG_NS) {
+    if (m_tickDeadline) {
+      m_timestepStats.numResyncs++;
+    }
+    // start the schedule from now
+    m_tickDeadline = now + TICK_NS;
+    return;
+  }
+  // sleep until the exact tick the deadline falls on, waking up late on one
+  // tick doesn't push back the next because each deadline is one tick after
+  // the last deadline rather than one tick after waking up
+  struct timespec ts;
+  ts.tv_sec = (time_t)(m_tickDeadline / 1000000000ull);
+  ts.tv_nsec = (long)(m_tickDeadline % 1000000000ull);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    // interrupted by a signal, go back to sleep
+  }
+  now = monotonic_ns();
+  uint64_t late = (now > m_tickDeadline) ? (now - m_tickDeadline) : 0;
+  m_timestepStats.numTicks++;
+  m_timestepStats.totalLate += late;
+  m_timestepStats.totalLateSquared += (double)late * (double)late;
+  if (late > m_timestepStats.maxLate) {
+    m_timestepStats.maxLate = late;
+  }
+  m_tickDeadline += TICK_NS;
+}
+#endif
+
 #ifdef HELIOS_EMBEDDED
 volatile uint32_t timer0_overflow_count = 0;
 ISR(TIMER0_OVF_vect) {
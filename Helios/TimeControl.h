@@ -39,19 +39,48 @@ public:
   static void delayMilliseconds(uint32_t ms);
 
 #ifdef HELIOS_CLI
+  // how far behind schedule the timestep woke up for each tick
+  struct TimestepStats
+  {
+    uint64_t numTicks;
+    // the total, total of squares and largest lateness in nanoseconds
+    uint64_t totalLate;
+    double totalLateSquared;
+    uint64_t maxLate;
+    // the number of times the clock fell too far behind and gave up catching up
+    uint32_t numResyncs;
+  };
+
   // toggle timestep on/off
   static void enableTimestep(bool enabled) { m_enableTimestep = enabled; }
+  // the timestep sleeps until each tick is due, spinning instead is a bit
+  // more precise but burns a whole core
+  static void enableSpinTimestep(bool enabled) { m_spinTimestep = enabled; }
+  static const TimestepStats &timestepStats() { return m_timestepStats; }
+  // jump the clock forward without running the ticks in between
+  static void advance(uint32_t numTicks) { m_curTick += numTicks; }
 #endif
 
 private:
   // global tick counter
-  static uint32_t m_curTick;
+  static HELIOS_TLS uint32_t m_curTick;
   // the last frame timestamp
-  static uint32_t m_prevTime;
+  static HELIOS_TLS uint32_t m_prevTime;
 
 #ifdef HELIOS_CLI
+  // the engine context swaps these globals in and out for each device
+  friend class HeliosEngine;
+
+  // sleep until the next tick is due
+  static void sleepTimestep();
+
   // whether timestep is enabled
-  static bool m_enableTimestep;
+  static HELIOS_TLS bool m_enableTimestep;
+  // whether the timestep spins instead of sleeping
+  static HELIOS_TLS bool m_spinTimestep;
+  // when the next tick is due on the monotonic clock, in nanoseconds
+  static HELIOS_TLS uint64_t m_tickDeadline;
+  static HELIOS_TLS TimestepStats m_timestepStats;
 #endif
 };
 
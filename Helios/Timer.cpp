@@ -57,3 +57,21 @@ bool Timer::alarm()
   m_startTime = now;
   return true;
 }
+
+#ifdef HELIOS_CLI
+uint32_t Timer::nextAlarm() const
+{
+  if (!m_alarm) {
+    return UINT32_MAX;
+  }
+  uint32_t now = Time::getCurtime();
+  int32_t timeDiff = (int32_t)(int64_t)(now - m_startTime);
+  // the start time itself always alarms
+  if (timeDiff <= 0) {
+    return m_startTime;
+  }
+  // otherwise the next multiple of the alarm after the start
+  uint32_t remainder = (uint32_t)timeDiff % m_alarm;
+  return remainder ? now + (m_alarm - remainder) : now;
+}
+#endif
@@ -20,6 +20,12 @@ public:
   // Will return the true if the timer hit
   bool alarm();
 
+#ifdef HELIOS_CLI
+  // the next tick at or after the current tick that alarm() would return
+  // true, or UINT32_MAX if the timer has no alarm
+  uint32_t nextAlarm() const;
+#endif
+
 private:
   // the alarm
   uint32_t m_alarm;
@@ -0,0 +1,118 @@
+#include <stdio.h>
+
+#include <vector>
+#include <chrono>
+
+#include "HeliosEngine.h"
+#include "PatternBatch.h"
+#include "TimeControl.h"
+#include "Patterns.h"
+#include "Pattern.h"
+#include "Led.h"
+
+#include "led_digest.h"
+#include "batch_bench.h"
+
+// the colorsets the patterns cycle through, each size groups differently
+static const Colorset bench_colorsets[] = {
+  Colorset(RGB_RED),
+  Colorset(RGB_RED, RGB_BLUE),
+  Colorset(RGB_RED, RGB_GREEN, RGB_BLUE),
+  Colorset(RGB_ORANGE, RGB_SEAFOAM, RGB_PURPLE, RGB_WHITE),
+  Colorset(RGB_RED, RGB_YELLOW, RGB_GREEN, RGB_TURQUOISE, RGB_BLUE, RGB_PINK),
+};
+#define NUM_BENCH_COLORSETS (sizeof(bench_colorsets) / sizeof(bench_colorsets[0]))
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// play the patterns one at a time with play() from the current tick of the
+// bound engine, the digest covers every frame of every pattern
+static uint64_t play_scalar(std::vector<Pattern> &patterns, uint32_t numTicks)
+{
+  uint32_t numPatterns = (uint32_t)patterns.size();
+  for (uint32_t i = 0; i < numPatterns; ++i) {
+    patterns[i].init();
+  }
+  // a pattern only sets the led when it changes, so each one keeps it's own
+  std::vector<RGBColor> leds(numPatterns, RGBColor(RGB_OFF));
+  uint64_t digest = FNV_OFFSET_BASIS;
+  for (uint32_t tick = 0; tick < numTicks; ++tick) {
+    for (uint32_t i = 0; i < numPatterns; ++i) {
+      Led::set(leds[i]);
+      patterns[i].play();
+      digest = digest_color(digest, leds[i] = Led::get());
+    }
+    Time::tickClock();
+  }
+  return digest;
+}
+
+int run_batch_bench(uint32_t numPatterns, uint32_t numTicks)
+{
+  // the patterns play against the clock of an engine that nothing else uses
+  HeliosEngine engine;
+  engine.enableStorage(false);
+  engine.bind();
+  Time::enableTimestep(false);
+  std::vector<Pattern> patterns(numPatterns);
+  for (uint32_t i = 0; i < numPatterns; ++i) {
+    Patterns::make_pattern((PatternID)(i % PATTERN_COUNT), patterns[i]);
+    patterns[i].setColorset(bench_colorsets[(i / PATTERN_COUNT) % NUM_BENCH_COLORSETS]);
+  }
+
+  // the batch compiles it's segment tables as patterns are added so that
+  // counts towards it's time, just like init() counts towards the scalar time
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  PatternBatch batch;
+  for (uint32_t i = 0; i < numPatterns; ++i) {
+    if (batch.add(patterns[i]) == UINT32_MAX) {
+      fprintf(stderr, "Pattern %u is too long to batch\n", i);
+      engine.unbind();
+      return 1;
+    }
+  }
+  uint64_t batchDigest = FNV_OFFSET_BASIS;
+  for (uint32_t tick = 0; tick < numTicks; ++tick) {
+    batch.step();
+    const uint8_t *red = batch.red();
+    const uint8_t *green = batch.green();
+    const uint8_t *blue = batch.blue();
+    for (uint32_t i = 0; i < numPatterns; ++i) {
+      batchDigest = digest_color(batchDigest, RGBColor(red[i], green[i], blue[i]));
+    }
+  }
+  double batchMs = elapsed_ms(start);
+
+  // the baseline is the plain state machine play() runs every tick, then the
+  // same again playing from the compiled timelines
+  bool timeline = Pattern::isTimelineEnabled();
+  Pattern::enableTimeline(false);
+  start = std::chrono::steady_clock::now();
+  uint64_t scalarDigest = play_scalar(patterns, numTicks);
+  double scalarMs = elapsed_ms(start);
+  Pattern::enableTimeline(true);
+  start = std::chrono::steady_clock::now();
+  uint64_t timelineDigest = play_scalar(patterns, numTicks);
+  double timelineMs = elapsed_ms(start);
+  Pattern::enableTimeline(timeline);
+  engine.unbind();
+
+  double frames = (double)numPatterns * numTicks;
+  printf("Patterns: %u ticks: %u\n", numPatterns, numTicks);
+  printf("  scalar:   %.3fms (%.0f pattern ticks/sec) digest=%016llx\n", scalarMs,
+      frames * 1000.0 / (scalarMs ? scalarMs : 1), (unsigned long long)scalarDigest);
+  printf("  timeline: %.3fms (%.0f pattern ticks/sec) digest=%016llx\n", timelineMs,
+      frames * 1000.0 / (timelineMs ? timelineMs : 1), (unsigned long long)timelineDigest);
+  printf("  batch:    %.3fms (%.0f pattern ticks/sec) digest=%016llx\n", batchMs,
+      frames * 1000.0 / (batchMs ? batchMs : 1), (unsigned long long)batchDigest);
+  if (batchDigest != scalarDigest || timelineDigest != scalarDigest) {
+    printf("MISMATCH\n");
+    return 1;
+  }
+  printf("match, batch is %.2fx the speed of scalar and %.2fx the speed of timeline\n",
+      batchMs ? scalarMs / batchMs : 0.0, batchMs ? timelineMs / batchMs : 0.0);
+  return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef BATCH_BENCH_H
+#define BATCH_BENCH_H
+
+#include <inttypes.h>
+
+// Play the same set of patterns one at a time with Pattern::play() and all
+// together with a PatternBatch and compare the two. The set cycles through
+// every built in pattern with colorsets of a few different sizes so it covers
+// blends and dashes, both runs digest every frame of every pattern so the
+// batch is checked against the real state machine as well as timed.
+//
+// Returns the process exit code, non-zero if the batch didn't match
+int run_batch_bench(uint32_t numPatterns, uint32_t numTicks);
+
+#endif
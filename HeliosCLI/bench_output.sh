@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Times how fast helios prints frames with nothing else slowing it down, run
+# it against an older build to compare:
+#
+#   ./bench_output.sh [helios] [ticks]
+
+HELIOS=${1:-./helios}
+NUM_TICKS=${2:-3000000}
+
+if [ ! -x "$HELIOS" ]; then
+    echo "Cannot find helios program: $HELIOS"
+    exit 1
+fi
+
+for OUTPUT in --hex --color --raw; do
+    START=$(date +%s%N)
+    "$HELIOS" --no-timestep --ticks "$NUM_TICKS" $OUTPUT < /dev/null > /dev/null
+    END=$(date +%s%N)
+    ELAPSED_MS=$(( (END - START) / 1000000 ))
+    if [ "$ELAPSED_MS" -eq 0 ]; then
+        ELAPSED_MS=1
+    fi
+    echo "$OUTPUT: $NUM_TICKS ticks in ${ELAPSED_MS}ms ($(( NUM_TICKS * 1000 / ELAPSED_MS )) ticks/sec)"
+done
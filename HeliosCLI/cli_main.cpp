@@ -5,7 +5,10 @@
 #include <string.h>
 #include <termios.h>
 #include <sys/select.h>
-#include <sys/ioctl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <math.h>
 #include <getopt.h>
 
 #include <string>
@@ -15,13 +18,26 @@
 #include <sstream>
 #include <algorithm>
 #include <map>
+#include <chrono>
 
 #include "Helios.h"
+#include "HeliosEngine.h"
 #include "TimeControl.h"
 #include "Storage.h"
 #include "Colortypes.h"
 #include "Button.h"
 #include "Led.h"
+#include "device_config.h"
+#include "farm.h"
+#include "render_cache.h"
+#include "batch_bench.h"
+#include "gallery.h"
+#include "render_batch.h"
+#include "trace.h"
+#include "led_digest.h"
+#include "output_writer.h"
+#include "input_script.h"
+#include "image_writer.h"
 #include "color_map.h"
 
 /*
@@ -36,42 +52,103 @@ enum OutputType {
   OUTPUT_TYPE_NONE,
   OUTPUT_TYPE_HEX,
   OUTPUT_TYPE_COLOR,
+  OUTPUT_TYPE_RAW,
 };
 
-// the default bmp filename
+// the default bmp and png filenames
 #define DEFAULT_BMP_FILENAME "pattern.bmp"
-// the size of the whole EEPROM, only half is actually used
-#define EEPROM_SIZE 512
+#define DEFAULT_PNG_FILENAME "pattern.png"
+// the number of renders the render cache holds in memory
+#define RENDER_CACHE_ENTRIES 64
+// the size of the buffer the frames are printed into
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+// the number of frames per second the in place display shows by default
+#define DEFAULT_DISPLAY_FPS 60
+// the size of each read of the input on stdin
+#define INPUT_READ_SIZE 4096
+// the number of ticks --bench-batch plays
+#define BATCH_BENCH_TICKS 20000
 
 // various globals for the tool
 OutputType output_type = OUTPUT_TYPE_COLOR;
 std::string bmp_filename = DEFAULT_BMP_FILENAME;
+std::string png_filename = DEFAULT_PNG_FILENAME;
 bool in_place = false;
+// the in place display shows this many frames per second, 0 shows every tick
+uint32_t display_fps = DEFAULT_DISPLAY_FPS;
+// whether each display frame is the average of it's ticks or just the last tick
+bool pov_blend = false;
 bool lockstep = false;
+bool tickless = false;
+bool rle = false;
 bool storage = false;
 bool timestep = true;
+bool report_jitter = false;
+bool report_storage = false;
+bool sync_storage = false;
+bool report_wear = false;
 bool eeprom = false;
 std::string eeprom_file;
 bool generate_bmp = false;
-std::vector<RGBColor> colorBuffer;
+bool generate_png = false;
+// every tick of the output colors streams straight into these images
+BMPWriter bmp_writer;
+PNGWriter png_writer;
 uint32_t num_cycles = 0;
 float brightness_scale = 1.0f;
 uint8_t minumum_brightness = 75;
-std::string initial_colorset_str = "";
-std::string initial_pattern_str = "";
-std::string initial_pattern_args_str = "";
-uint32_t initial_mode_index = 0;
+DeviceConfig initial_config;
+std::string farm_file;
+std::string gallery_dir;
+std::string batch_manifest;
+uint32_t num_threads = 0;
+std::string render_cache_dir;
+uint32_t bench_batch_patterns = 0;
+std::string record_file;
+std::string replay_file;
+bool verify_replay = false;
+uint32_t max_ticks = 0;
+std::vector<std::string> input_files;
+bool digest = false;
+// only every Nth tick is output and the ticks left until the next one
+uint32_t frame_every = 1;
+uint32_t frame_wait = 0;
+// the frames are formatted into this and written out in blocks
+OutputWriter output(STDOUT_FILENO, OUTPUT_BUFFER_SIZE);
+// whether the end of the input on stdin was reached
+bool input_finished = false;
+// the ticks collected for the next display frame and the sum of their colors
+uint32_t display_ticks = 0;
+uint64_t display_red = 0;
+uint64_t display_green = 0;
+uint64_t display_blue = 0;
+RGBColor display_color;
+// the run of identical frames that is still being collected for the output
+RGBColor run_color;
+uint32_t run_length = 0;
 
 // used to switch terminal to non-blocking and back
 static struct termios orig_term_attr = {0};
 
 // internal functions
 static void parse_options(int argc, char *argv[]);
-static bool read_inputs();
-static void show();
+static bool read_inputs(bool wait_for_end = false);
+static bool wait_for_input();
+static void print_jitter();
+static void print_storage_stats();
+static void print_wear();
+static void show(uint32_t numTicks);
+static void show_color(RGBColor scaledColor, uint32_t numTicks);
+static bool show_cached_cycles();
+static int run_digest();
+static void show_display(RGBColor scaledColor, uint32_t numTicks);
+static void flush_display();
+static void print_frame(RGBColor color, uint32_t runLength);
+static void print_text_frame(RGBColor color, uint32_t runLength);
+static void flush_run();
 static void restore_terminal();
 static void set_terminal_nonblocking();
-static bool writeBMP(const std::string& filename, const std::vector<RGBColor>& colors);
+static bool close_image(bool opened, bool closed, uint64_t numPixels, const std::string &filename);
 static void print_usage(const char* program_name);
 static bool parse_eep_file(const std::string& filename, std::vector<uint8_t>& memory);
 static bool parse_csv_hex(const std::string& filename, std::vector<uint8_t>& memory);
@@ -82,6 +159,33 @@ int main(int argc, char *argv[])
 {
   // parse command line options
   parse_options(argc, argv);
+  // the device farm runs it's own engines and doesn't use stdin
+  if (farm_file.length() > 0) {
+    return run_farm(farm_file, num_threads);
+  }
+  // as does the gallery, it renders every pattern on the same pool of threads
+  if (gallery_dir.length() > 0) {
+    return run_gallery(gallery_dir, num_threads, render_cache_dir);
+  }
+  // and a batch of renders
+  if (batch_manifest.length() > 0) {
+    return run_render_batch(batch_manifest, num_threads, render_cache_dir);
+  }
+  // so does the batch benchmark
+  if (bench_batch_patterns > 0) {
+    return run_batch_bench(bench_batch_patterns, BATCH_BENCH_TICKS);
+  }
+  // the storage reports cover a replayed trace too
+  if (report_storage) {
+    atexit(print_storage_stats);
+  }
+  if (report_wear) {
+    atexit(print_wear);
+  }
+  // and replaying a trace, the trace holds all of the inputs
+  if (replay_file.length() > 0) {
+    return run_replay(replay_file, verify_replay);
+  }
   // set the terminal to instantly receive key presses
   set_terminal_nonblocking();
   // if parsing an eeprom then no need to initialize helios
@@ -90,126 +194,206 @@ int main(int argc, char *argv[])
     dump_eeprom(eeprom_file);
     return 0;
   }
+  // input files take the place of stdin and are compiled into the input
+  // queue before the first tick, one after the other
+  if (input_files.size() > 0) {
+    for (size_t i = 0; i < input_files.size(); ++i) {
+      if (!queue_input_file(input_files[i])) {
+        return 1;
+      }
+    }
+    input_finished = true;
+  }
+  // tickless mode takes the whole input up front and jumps straight from one
+  // event to the next, so it can't keep time or wait for live input
+  if (tickless) {
+    timestep = false;
+    rle = true;
+    while (read_inputs(true)) { }
+  }
+  // so does the digest, it doesn't touch stdin or stdout while running
+  if (digest) {
+    timestep = false;
+    while (read_inputs(true)) { }
+  }
   // toggle timestep in the engine based on the cli input
   Time::enableTimestep(timestep);
+  if (report_jitter) {
+    atexit(print_jitter);
+  }
   // toggle storage in the engine based on cli input
   Storage::enableStorage(storage);
+  Storage::enableSyncWrites(sync_storage);
+  // a trace starts from whatever was in storage before the engine touched it
+  std::vector<uint8_t> trace_storage;
+  if (record_file.length() > 0 && storage) {
+    // a missing storage file gets created full of zeros
+    trace_storage.resize(STORAGE_SIZE, 0);
+    FILE *f = fopen(STORAGE_FILENAME, "rb");
+    if (f) {
+      size_t len = fread(trace_storage.data(), 1, STORAGE_SIZE, f);
+      (void)len;
+      fclose(f);
+    }
+  }
   // run the engine initialization
   Helios::init();
-  // set the initial mode index
-  Helios::set_mode_index(initial_mode_index);
-  // Set the initial pattern based on user arguments
-  if (initial_pattern_str.length() > 0) {
-    // convert the string arg to integer, then treat it as a PatternID
-    PatternID id = (PatternID)strtoul(initial_pattern_str.c_str(), NULL, 10);
-    // pass the current pattern to make_pattern to update it's internals
-    Patterns::make_pattern(id, Helios::cur_pattern());
-    // re-initialize the current pattern
-    Helios::cur_pattern().init();
-  }
-  // set initial pattern args based on user arguments
-  if (initial_pattern_args_str.length() > 0) {
-    // parse the list of args into an array of ints
-    std::vector<uint32_t> vals;
-    std::istringstream ss(initial_pattern_args_str);
-    // push 6 args into the array
-    while (vals.size() < 6) {
-      std::string arg;
-      uint32_t val = 0;
-      // try to parse out a number
-      if (std::getline(ss, arg, ',')) {
-        val = strtoul(arg.c_str(), NULL, 10);
-      }
-      // push the val either 0 or parsed number
-      vals.push_back(val);
+  // set the initial mode index, pattern and colorset
+  apply_device_config(initial_config);
+  // just generate eeprom?
+  if (eeprom) {
+    return 0;
+  }
+  if (digest) {
+    return run_digest();
+  }
+  // the images are written as the frames come in
+  if (generate_bmp && !bmp_writer.open(bmp_filename)) {
+    std::cerr << "Failed to open file: " << bmp_filename << " (" << strerror(errno) << ")" << std::endl;
+    return 1;
+  }
+  // the png is a strip that grows as it goes
+  if (generate_png && !png_writer.open(png_filename, 0, 1, false)) {
+    std::cerr << "Failed to open file: " << png_filename << " (" << strerror(errno) << ")" << std::endl;
+    return 1;
+  }
+  // the number of ticks left to render when a number of cycles was requested
+  uint64_t cycle_ticks = 0;
+  if (num_cycles > 0) {
+    Pattern &pat = Helios::cur_pattern();
+    // start right where the pattern begins repeating (unless a seek was given)
+    // so the output is exactly the requested number of periods
+    if (!initial_config.seek) {
+      pat.seek(pat.periodStart());
     }
-    // construct pattern args from the array of values
-    PatternArgs args(vals[0], vals[1], vals[2], vals[3], vals[4], vals[5]);
-    // set the args of the current pattern
-    Helios::cur_pattern().setArgs(args);
-  }
-  // Set the initial colorset based on user arguments
-  if (initial_colorset_str.length() > 0) {
-    std::stringstream ss(initial_colorset_str);
-    std::string color;
-    Colorset set;
-    while (getline(ss, color, ',')) {
-      // iterate letters and lowercase them
-      std::transform(color.begin(), color.end(), color.begin(), [](unsigned char c){ return tolower(c); });
-      if (color_map.count(color) > 0) {
-        set.addColor(color_map[color]);
-      } else {
-        set.addColor(strtoul(color.c_str(), nullptr, 16));
+    cycle_ticks = (uint64_t)num_cycles * pat.period();
+    // the render cache can serve the cycles without simulating anything
+    if (render_cache_dir.length() > 0 && !initial_config.seek && record_file.empty()) {
+      if (!show_cached_cycles()) {
+        return 1;
       }
+      Helios::terminate();
     }
-    // update the colorset of the current pattern
-    Helios::cur_pattern().setColorset(set);
-    // re-initialize the current pattern
-    Helios::cur_pattern().init();
   }
-  // just generate eeprom?
-  if (eeprom) {
-    return 0;
+  // record the session to a trace
+  TraceWriter trace;
+  if (record_file.length() > 0) {
+    DeviceConfig config = initial_config;
+    if (num_cycles > 0 && !config.seek) {
+      // the cycles start from a seek the trace has to reproduce
+      config.seek = Helios::cur_pattern().periodStart();
+    }
+    if (!trace.open(record_file, config, storage ? trace_storage.data() : nullptr)) {
+      return 1;
+    }
   }
-  // keep track of the number of cycles and the last colorset index each tick
-  // so that we can detect when one full cycle of the pattern has passed
-  uint32_t cycle_count = 0;
-  uint8_t last_index = 0;
+  // the ticks since the session started, the engine clock can't be used for
+  // the trace because it starts over when the device wakes up
+  uint32_t session_ticks = 0;
   while (Helios::keep_going()) {
     // check for any inputs and read the next one
     read_inputs();
     // if lockstep is enabled, only run logic if the
     // input queue isn't actually empty
     if (lockstep && !Button::inputQueueSize()) {
-      // just keep waiting for an input
+      // sleep until the next input arrives, once the input has ended there
+      // will never be another step
+      if (!wait_for_input()) {
+        break;
+      }
       continue;
     }
+    // the input the button may process this tick
+    uint32_t numQueued = Button::inputQueueSize();
+    char input = Button::nextInput();
     // run the main loop
     Helios::tick();
+    if (record_file.length() > 0) {
+      // waits don't need recording, they are just the time between records
+      if (Button::inputQueueSize() < numQueued && input != 'w') {
+        trace.input(session_ticks, input);
+      }
+      trace.color(session_ticks, Led::get());
+    }
+    // the number of ticks this frame is shown for
+    uint32_t numTicks = 1;
+    // the tick that quit is the last one, there is nothing to skip to
+    if (tickless && Helios::keep_going()) {
+      // every tick until the next event would be identical to this one
+      uint32_t next = Helios::next_event_tick();
+      if (next == UINT32_MAX) {
+        // nothing will ever change again so there is nothing left to simulate
+        Helios::terminate();
+      } else {
+        numTicks += next - Time::getCurtime();
+        Helios::skip_to(next);
+      }
+    }
+    // stop right at the tick count if one was given
+    if (max_ticks > 0 && numTicks >= max_ticks - session_ticks) {
+      numTicks = max_ticks - session_ticks;
+      Helios::terminate();
+    }
+    session_ticks += numTicks;
     // don't render anything if asleep, but technically it's still running...
     if (Helios::is_asleep()) {
       continue;
     }
-    // watch for a full cycle if it was requested by the command line
+    // stop right at the end of the last cycle if cycles were requested
     if (num_cycles > 0) {
-      // grab the current index of the colorset, which might be the same for
-      // several tick in a row, so we must check whether it just changed this
-      // tick by comparing it to the index we saved last tick
-      uint8_t cur_index = Helios::cur_pattern().colorset().curIndex();
-      if (cur_index == 0 && last_index != 0) {
-        // only if the current index is 0 (start of colorset) and the last index was
-        // not 0 then the colorset *just* started iterating through it's colors, so
-        // count this as +1 cycle in the cycle count
-        cycle_count++;
+      if (numTicks > cycle_ticks) {
+        numTicks = (uint32_t)cycle_ticks;
       }
-      // then if we run more than the chosen number of cycles just quit
-      if (cycle_count >= num_cycles) {
+      cycle_ticks -= numTicks;
+      if (!cycle_ticks) {
         Helios::terminate();
-        break;
       }
-      last_index = cur_index;
     }
     // render the output of the main loop
-    show();
+    show(numTicks);
   }
-  // if the user requested a bmp file to be written
-  if (generate_bmp) {
-    // if they didn't record anything give them a message indicating they need to record
-    if (!colorBuffer.size()) {
-      std::cout << "Cannot generate BMP! Color buffer is empty" << std::endl;
-      return 0;
-    }
-    std::cout << "Writing " << colorBuffer.size() << " colors to " << bmp_filename << std::endl;
-    // try to write out however many colors they recorded to the bmp file
-    if (!writeBMP(bmp_filename.c_str(), colorBuffer)) {
-      // non-zero exit code means the utility failed it's job
-      return 1;
-    }
+  // print whatever frame or run was still being collected
+  flush_display();
+  flush_run();
+  output.flush();
+  if (record_file.length() > 0 && !trace.close(session_ticks)) {
+    return 1;
+  }
+  // finish off the images the user requested, non-zero exit code means the
+  // utility failed it's job
+  uint64_t bmpPixels = bmp_writer.numPixels();
+  uint64_t pngPixels = png_writer.numPixels();
+  if (!close_image(generate_bmp, generate_bmp && bmp_writer.close(), bmpPixels, bmp_filename)) {
+    return 1;
+  }
+  if (!close_image(generate_png, generate_png && png_writer.close(), pngPixels, png_filename)) {
+    return 1;
   }
 
   return 0;
 }
 
+// report on an image that was written as the frames came in, returns false
+// if it failed
+static bool close_image(bool opened, bool closed, uint64_t numPixels, const std::string &filename)
+{
+  if (!opened) {
+    return true;
+  }
+  // if they didn't record anything give them a message indicating they need to record
+  if (!numPixels) {
+    std::cout << "Cannot generate image! No frames were recorded" << std::endl;
+    unlink(filename.c_str());
+    return true;
+  }
+  if (!closed) {
+    std::cerr << "Error writing to file: " << filename << std::endl;
+    return false;
+  }
+  std::cout << "Wrote " << numPixels << " colors to " << filename << std::endl;
+  return true;
+}
+
 // parse the command line options into global flags
 static void parse_options(int argc, char *argv[])
 {
@@ -220,9 +404,20 @@ static void parse_options(int argc, char *argv[])
     {"color", no_argument, nullptr, 'c'},
     {"quiet", no_argument, nullptr, 'q'},
     {"lockstep", no_argument, nullptr, 'l'},
+    {"tickless", no_argument, nullptr, 'T'},
+    {"rle", no_argument, nullptr, 'r'},
+    {"timeline", no_argument, nullptr, 'X'},
+    {"no-timeline", no_argument, nullptr, 'N'},
     {"no-timestep", no_argument, nullptr, 't'},
+    {"spin", no_argument, nullptr, 'U'},
+    {"jitter", no_argument, nullptr, 'J'},
     {"in-place", no_argument, nullptr, 'i'},
+    {"fps", required_argument, nullptr, 'f'},
+    {"pov", no_argument, nullptr, 'v'},
     {"storage", no_argument, nullptr, 's'},
+    {"storage-stats", no_argument, nullptr, 'Z'},
+    {"sync-storage", no_argument, nullptr, 'Y'},
+    {"wear", no_argument, nullptr, 'w'},
     {"cycle", optional_argument, nullptr, 'y'},
     {"brightness-scale", required_argument, nullptr, 'a'},
     {"min-brightness", required_argument, nullptr, 'm'},
@@ -230,13 +425,29 @@ static void parse_options(int argc, char *argv[])
     {"pattern", required_argument, nullptr, 'P'},
     {"pattern-args", required_argument, nullptr, 'A'},
     {"mode-index", required_argument, nullptr, 'I'},
+    {"seek", required_argument, nullptr, 'K'},
     {"bmp", optional_argument, nullptr, 'b'},
+    {"png", optional_argument, nullptr, 'g'},
     {"eeprom", no_argument, nullptr, 'E'},
     {"parse-save", required_argument, nullptr, 'S'},
+    {"farm", required_argument, nullptr, 'F'},
+    {"gallery", required_argument, nullptr, 'G'},
+    {"batch", required_argument, nullptr, 'M'},
+    {"threads", required_argument, nullptr, 'j'},
+    {"render-cache", required_argument, nullptr, 'R'},
+    {"bench-batch", required_argument, nullptr, 'B'},
+    {"ticks", required_argument, nullptr, 'k'},
+    {"input-file", required_argument, nullptr, 'n'},
+    {"digest", no_argument, nullptr, 'D'},
+    {"record", required_argument, nullptr, 'O'},
+    {"replay", required_argument, nullptr, 'L'},
+    {"verify", no_argument, nullptr, 'V'},
+    {"raw", optional_argument, nullptr, 'W'},
+    {"every", required_argument, nullptr, 'e'},
     {"help", no_argument, nullptr, 'h'},
     {nullptr, 0, nullptr, 0}
   };
-  while ((opt = getopt_long(argc, argv, "xcqltisyamC:P:A:I:b::ES:h", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "xcqlTrXNtisZYwyamC:P:A:I:K:b::g::ES:F:G:M:j:R:B:k:DO:L:VW::e:UJf:vn:h", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'x':
       // if the user wants pretty colors or hex codes
@@ -249,22 +460,86 @@ static void parse_options(int argc, char *argv[])
     case 'q':
       output_type = OUTPUT_TYPE_NONE;
       break;
+    case 'W':
+      // packed binary frames for other programs to read
+      output_type = OUTPUT_TYPE_RAW;
+      // allow for a space between the -W and the file descriptor
+      if (optarg == NULL && optind < argc && isdigit(argv[optind][0])) {
+        optarg = argv[optind++];
+      }
+      // if a file descriptor was provided write the frames there instead of stdout
+      if (optarg) {
+        int fd = (int)strtol(optarg, NULL, 10);
+        if (fcntl(fd, F_GETFD) < 0) {
+          printf("Bad file descriptor for --raw: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        output.setFd(fd);
+      }
+      break;
     case 'l':
       // if the user wants to step in lockstep with the engine
       lockstep = true;
       break;
+    case 'T':
+      // jump from event to event and print runs of identical frames
+      tickless = true;
+      break;
+    case 'r':
+      // print each run of identical frames once with its tick count
+      rle = true;
+      break;
+    case 'X':
+      // play the patterns from their compiled timelines
+      Pattern::enableTimeline(true);
+      break;
+    case 'N':
+      // run every tick of the patterns through the state machine
+      Pattern::enableTimeline(false);
+      break;
     case 't':
       // turn off timestep
       timestep = false;
       break;
+    case 'U':
+      // spin between ticks instead of sleeping
+      Time::enableSpinTimestep(true);
+      break;
+    case 'J':
+      // print how late the ticks were at the end
+      report_jitter = true;
+      break;
     case 'i':
       // if the user wants to print in-place (on one line)
       in_place = true;
       break;
+    case 'f':
+      // the frame rate of the in place display, 0 shows every tick
+      display_fps = strtoul(optarg, NULL, 10);
+      if (display_fps > TICKRATE) {
+        display_fps = TICKRATE;
+      }
+      break;
+    case 'v':
+      // average the ticks of each display frame
+      pov_blend = true;
+      break;
     case 's':
       // TODO: implement storage filename
       storage = true;
       break;
+    case 'Z':
+      // print the storage counters at the end
+      report_storage = true;
+      break;
+    case 'Y':
+      // model the old eeprom writes that waited on every byte
+      sync_storage = true;
+      break;
+    case 'w':
+      // print how much the saves wore the eeprom at the end
+      report_wear = true;
+      break;
     case 'y':
       // set the number of cycles to default 1
       num_cycles = 1;
@@ -309,19 +584,23 @@ static void parse_options(int argc, char *argv[])
       break;
     case 'C':
       // set the initial colorset from the string
-      initial_colorset_str = optarg;
+      initial_config.colorset = optarg;
       break;
     case 'P':
       // set the initial pattern from the string
-      initial_pattern_str = optarg;
+      initial_config.pattern = optarg;
       break;
     case 'A':
       // set the initial pattern args from the string
-      initial_pattern_args_str = optarg;
+      initial_config.pattern_args = optarg;
       break;
     case 'I':
       // set the initial mode index
-      initial_mode_index = strtoul(optarg, NULL, 10);
+      initial_config.mode_index = strtoul(optarg, NULL, 10);
+      break;
+    case 'K':
+      // start the pattern this many ticks in
+      initial_config.seek = strtoul(optarg, NULL, 10);
       break;
     case 'b':
       // generate a bmp file
@@ -335,12 +614,78 @@ static void parse_options(int argc, char *argv[])
         bmp_filename = optarg;
       }
       break;
+    case 'g':
+      // generate a png file
+      generate_png = true;
+      // allow for a space between the -g and the filename
+      if (optarg == NULL && optind < argc && argv[optind][0] != '-') {
+        optarg = argv[optind++];
+      }
+      if (optarg) {
+        png_filename = optarg;
+      }
+      break;
     case 'E':
       eeprom = true;
       break;
     case 'S':
       eeprom_file = optarg;
       break;
+    case 'F':
+      // run a list of jobs on the device farm
+      farm_file = optarg;
+      break;
+    case 'G':
+      // render the images of every pattern in the directory
+      gallery_dir = optarg;
+      break;
+    case 'M':
+      // render every job in a manifest
+      batch_manifest = optarg;
+      break;
+    case 'j':
+      // the number of farm threads, 0 is one per core
+      num_threads = strtoul(optarg, NULL, 10);
+      break;
+    case 'R':
+      // the directory to keep cycle renders in
+      render_cache_dir = optarg;
+      break;
+    case 'B':
+      // compare playing many patterns one by one against a pattern batch
+      bench_batch_patterns = strtoul(optarg, NULL, 10);
+      break;
+    case 'k':
+      // stop after this many ticks
+      max_ticks = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      // read the inputs from a script file instead of stdin
+      input_files.push_back(optarg);
+      break;
+    case 'D':
+      // run flat out and only print a digest of the output and the final state
+      digest = true;
+      break;
+    case 'O':
+      // record the inputs and led output to a binary trace
+      record_file = optarg;
+      break;
+    case 'L':
+      // replay a binary trace instead of reading inputs
+      replay_file = optarg;
+      break;
+    case 'V':
+      // check the led output of the replay against the trace
+      verify_replay = true;
+      break;
+    case 'e':
+      // only output every Nth tick
+      frame_every = strtoul(optarg, NULL, 10);
+      if (!frame_every) {
+        frame_every = 1;
+      }
+      break;
     case 'h':
       // print usage and exit
       print_usage(argv[0]);
@@ -352,96 +697,333 @@ static void parse_options(int argc, char *argv[])
   }
 }
 
-// read the input from stdin to control the tool
-static bool read_inputs()
+// read the input from stdin to control the tool, whatever has arrived is
+// queued each time this is called so a file redirected into stdin is read all
+// at once the first time. A pipe is only waited on until it closes when the
+// whole script is needed up front, otherwise a pipe that stays open without
+// writing anything would hang the tool. Returns false if there was nothing
+// new to read
+static bool read_inputs(bool wait_for_end)
 {
-  // keep track of the number of inputs and only process
-  // one input per tick
-  static uint32_t numInputs = 0;
-  // check for any inputs on stdin if theres no inputs left
-  if (!numInputs) {
-    // this will capture the number of characters on stdin
-    ioctl(STDIN_FILENO, FIONREAD, &numInputs);
-    if (!numInputs) {
-      return false;
-    }
+  // input that was read but not queued yet, a repeat count can be typed
+  // or read in pieces before the command that ends it
+  static std::string pending;
+  if (input_finished) {
+    return false;
   }
-  // otherwise process the next input if there is one
-  if (numInputs > 0) {
-    numInputs--;
-    char command = getchar();
-    uint32_t repeatAmount = 1;
-    if (isdigit(command)) {
-      repeatAmount = command - '0';
-      char newc = 0;
-      // read the digits into the repeatAmount
-      while (1) {
-        numInputs--;
-        newc = getchar();
-        if (!isdigit(newc)) {
-          // stop once we reach a non digit
-          break;
-        }
-        // accumulate the digits into the repeat amount
-        repeatAmount = (repeatAmount * 10) + (newc - '0');
-      }
-      command = newc;
+  bool script = !isatty(STDIN_FILENO);
+  bool received = false;
+  char buf[INPUT_READ_SIZE];
+  while (true) {
+    ssize_t len = read(STDIN_FILENO, buf, sizeof(buf));
+    if (len > 0) {
+      pending.append(buf, len);
+      received = true;
+      continue;
+    }
+    if (len == 0) {
+      input_finished = true;
+      break;
     }
-    for (uint32_t i = 0; i < repeatAmount; ++i) {
-      // otherwise just queue up the command
-      Button::queueInput(command);
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN && script && wait_for_end) {
+      // stdin is non-blocking, wait for the rest of the script to arrive
+      wait_for_input();
+      continue;
     }
+    // nothing more to read for now
+    break;
+  }
+  // repeated commands are queued as a single run so long waits cost nothing
+  const char *queued = queue_input_runs(pending.data(), pending.data() + pending.size());
+  pending.erase(0, queued - pending.data());
+  return received;
+}
+
+// sleep until there is something to read on stdin, returns false right away
+// if the input already ended because nothing will ever arrive
+static bool wait_for_input()
+{
+  if (input_finished) {
+    return false;
+  }
+  struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+    // interrupted by a signal, go back to waiting
   }
   return true;
 }
 
-// render the led
-static void show()
+// render the led for a number of ticks
+static void show(uint32_t numTicks)
 {
+  // Get the current color and scale its brightness up
+  RGBColor currentColor = {Led::get().red, Led::get().green, Led::get().blue};
+  show_color(currentColor.scaleBrightness(brightness_scale), numTicks);
+}
+
+static void show_color(RGBColor scaledColor, uint32_t numTicks)
+{
+  // record every tick of the output colors for the images, even if they
+  // have chosen the -q for quiet option
+  if (generate_bmp) {
+    bmp_writer.write(scaledColor, numTicks);
+  }
+  if (generate_png) {
+    png_writer.write(scaledColor, numTicks);
+  }
   if (output_type == OUTPUT_TYPE_NONE) {
-    if (generate_bmp) {
-      // still need to generate the BMP by recoring all the output colors
-      // even if they have chosen the -q for quiet option
-      RGBColor currentColor = {Led::get().red, Led::get().green, Led::get().blue};
-      RGBColor scaledColor = currentColor.scaleBrightness(brightness_scale);
-      colorBuffer.push_back(scaledColor);
+    return;
+  }
+  // work out how many of the output ticks land in these ticks
+  uint32_t numFrames = numTicks;
+  if (frame_every > 1) {
+    if (numTicks <= frame_wait) {
+      frame_wait -= numTicks;
+      return;
+    }
+    numFrames = 1 + ((numTicks - frame_wait - 1) / frame_every);
+    frame_wait = frame_every - 1 - ((numTicks - frame_wait - 1) % frame_every);
+  }
+  if (in_place && !rle && display_fps > 0) {
+    show_display(scaledColor, numFrames);
+    return;
+  }
+  if (!rle) {
+    for (uint32_t i = 0; i < numFrames; ++i) {
+      print_frame(scaledColor, 0);
     }
     return;
   }
-  std::string out;
+  // consecutive ticks or events can show the same color so merge them into one run
+  if (run_length > 0 && scaledColor == run_color) {
+    run_length += numFrames;
+    return;
+  }
+  flush_run();
+  run_color = scaledColor;
+  run_length = numFrames;
+}
+
+// the in place display doesn't need a frame for every tick because a terminal
+// can only show so many frames a second, the ticks are collected into frames
+// at the display rate instead
+static void show_display(RGBColor scaledColor, uint32_t numTicks)
+{
+  display_ticks += numTicks;
+  display_red += (uint64_t)scaledColor.red * numTicks;
+  display_green += (uint64_t)scaledColor.green * numTicks;
+  display_blue += (uint64_t)scaledColor.blue * numTicks;
+  display_color = scaledColor;
+  uint32_t ticksPerFrame = TICKRATE / display_fps;
+  if (display_ticks >= ticksPerFrame) {
+    flush_display();
+  }
+}
+
+// print the display frame collected so far, with pov blending it's the average
+// of the ticks like an eye would see a fast strobe, otherwise the last tick
+static void flush_display()
+{
+  if (!display_ticks) {
+    return;
+  }
+  RGBColor col = display_color;
+  if (pov_blend) {
+    col.red = (uint8_t)(display_red / display_ticks);
+    col.green = (uint8_t)(display_green / display_ticks);
+    col.blue = (uint8_t)(display_blue / display_ticks);
+  }
+  print_frame(col, 0);
+  display_ticks = 0;
+  display_red = 0;
+  display_green = 0;
+  display_blue = 0;
+}
+
+// the names of the states of the device in the order Helios declares them
+static const char *state_names[] = {
+  "modes",
+  "color_select_slot",
+  "color_select_quadrant",
+  "color_select_hue",
+  "color_select_sat",
+  "color_select_val",
+  "pattern_select",
+  "toggle_conjure",
+  "toggle_lock",
+  "set_defaults",
+  "set_global_brightness",
+  "shift_mode",
+  "randomize",
+  "sleep",
+};
+
+// run the engine flat out without any per tick input or output, then print a
+// digest of the led output and the final state of the device. With no tick
+// count it stops once the input runs out
+static int run_digest()
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+  uint64_t ticks = 0;
+  uint64_t frames = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (Helios::keep_going() && (max_ticks ? ticks < max_ticks : Button::inputQueueSize() > 0)) {
+    Helios::tick();
+    ticks++;
+    // the CLI doesn't show anything while the device is asleep
+    if (Helios::is_asleep()) {
+      continue;
+    }
+    hash = digest_color(hash, Led::get().scaleBrightness(brightness_scale));
+    frames++;
+  }
+  double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  Pattern &pat = Helios::cur_pattern();
+  PatternArgs args = pat.getArgs();
+  uint8_t state = Helios::cur_state_index();
+  printf("ticks=%llu frames=%llu digest=%016llx\n", (unsigned long long)ticks,
+      (unsigned long long)frames, (unsigned long long)hash);
+  printf("state=%s mode=%u locked=%u conjure=%u\n",
+      (state < sizeof(state_names) / sizeof(state_names[0])) ? state_names[state] : "unknown",
+      Helios::cur_mode_index(), Helios::has_flag(Helios::FLAG_LOCKED),
+      Helios::has_flag(Helios::FLAG_CONJURE));
+  printf("args=%u,%u,%u,%u,%u,%u colorset=", args.on_dur, args.off_dur, args.gap_dur,
+      args.dash_dur, args.group_size, args.blend_speed);
+  for (uint8_t i = 0; i < pat.colorset().numColors(); ++i) {
+    printf("%s%06X", i ? "," : "", pat.colorset().get(i).raw());
+  }
+  printf("\n");
+  // the speed goes to stderr so the output can be compared against a golden copy
+  fprintf(stderr, "Ran %llu ticks in %.3fms (%.0f ticks/sec)\n", (unsigned long long)ticks,
+      elapsed_ms, ticks * 1000.0 / (elapsed_ms ? elapsed_ms : 1));
+  return 0;
+}
+
+// show the cycles of the first mode from the render cache
+static bool show_cached_cycles()
+{
+  // it's fine if the directory already exists
+  if (mkdir(render_cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror("Failed to create render cache directory");
+    return false;
+  }
+  RenderCache cache(RENDER_CACHE_ENTRIES, render_cache_dir);
+  std::shared_ptr<const RenderCache::Frames> frames = cache.render(Helios::cur_pattern(), brightness_scale, num_cycles);
+  for (size_t i = 0; i < frames->size(); ++i) {
+    show_color((*frames)[i], 1);
+  }
+  fprintf(stderr, "Render cache: %llu hits, %llu loaded, %llu misses\n", (unsigned long long)cache.hits(),
+      (unsigned long long)cache.diskHits(), (unsigned long long)cache.misses());
+  return true;
+}
+
+// print a single frame, or a run of identical frames if the run length is set
+static void print_frame(RGBColor color, uint32_t runLength)
+{
+  if (output_type == OUTPUT_TYPE_RAW) {
+    // three bytes per frame without any separators, each run is followed by
+    // it's length as a four byte little endian count
+    output.putRGB(color);
+    if (runLength > 0) {
+      output.putUint32(runLength);
+    }
+  } else {
+    print_text_frame(color, runLength);
+  }
+  // anyone watching needs to see each frame as it happens, otherwise the
+  // frames go out in big blocks
+  if (in_place || timestep || lockstep) {
+    output.flush();
+  }
+}
+
+// print a frame as color codes or hex
+static void print_text_frame(RGBColor color, uint32_t runLength)
+{
   if (in_place) {
     // this resets the cursor back to the beginning of the line
-    out += "\r";
+    output.put('\r');
   }
-  // Get the current color and scale its brightness up
-  RGBColor currentColor = {Led::get().red, Led::get().green, Led::get().blue};
-  RGBColor scaledColor = currentColor.scaleBrightness(brightness_scale);
   if (output_type == OUTPUT_TYPE_COLOR) {
-    out += "\x1B[0m["; // opening |
-    out += "\x1B[48;2;"; // colorcode start
-    out += std::to_string(scaledColor.red) + ";"; // col red
-    out += std::to_string(scaledColor.green) + ";"; // col green
-    out += std::to_string(scaledColor.blue) + "m"; // col blue
-    out += "  "; // colored space
-    out += "\x1B[0m]"; // ending |
+    output.write("\x1B[0m["); // opening |
+    output.write("\x1B[48;2;"); // colorcode start
+    output.putDecimal(color.red); // col red
+    output.put(';');
+    output.putDecimal(color.green); // col green
+    output.put(';');
+    output.putDecimal(color.blue); // col blue
+    output.put('m');
+    output.write("  "); // colored space
+    output.write("\x1B[0m]"); // ending |
   } else if (output_type == OUTPUT_TYPE_HEX) {
     // otherwise this just prints out the raw hex code if not in color mode
-    for (uint32_t i = 0; i < output_type; ++i) {
-      char buf[128] = { 0 };
-      snprintf(buf, sizeof(buf), "%02X%02X%02X", scaledColor.red, scaledColor.green, scaledColor.blue);
-      out += buf;
-    }
+    output.putHex(color);
   }
-  // if the engine
-  if (generate_bmp) {
-    // Add scaled color to buffer
-    colorBuffer.push_back(scaledColor);
+  if (runLength > 0) {
+    // the number of ticks the frame is held for
+    output.put(' ');
+    output.putDecimal(runLength);
   }
   if (!in_place) {
-    out += "\n";
+    output.put('\n');
+  }
+}
+
+// print the run of frames collected by tickless or rle mode
+static void flush_run()
+{
+  if (!run_length) {
+    return;
+  }
+  print_frame(run_color, run_length);
+  run_length = 0;
+}
+
+// installed as an exit handler to print how closely the timestep kept time
+static void print_jitter()
+{
+  const Time::TimestepStats &stats = Time::timestepStats();
+  if (!stats.numTicks) {
+    fprintf(stderr, "Jitter: no ticks were timed, the timestep is off or spinning\n");
+    return;
+  }
+  double mean = (double)stats.totalLate / stats.numTicks;
+  double variance = (stats.totalLateSquared / stats.numTicks) - (mean * mean);
+  double deviation = (variance > 0) ? sqrt(variance) : 0;
+  fprintf(stderr, "Jitter: %llu ticks late by %.1fus on average, %.1fus at most, %.1fus deviation, %u resyncs\n",
+      (unsigned long long)stats.numTicks, mean / 1000.0, stats.maxLate / 1000.0, deviation / 1000.0,
+      stats.numResyncs);
+}
+
+static void print_storage_stats()
+{
+  fprintf(stderr, "Storage: %llu reads, %llu writes, %llu flushes\n",
+      (unsigned long long)Storage::numReads(), (unsigned long long)Storage::numWrites(),
+      (unsigned long long)Storage::numFlushes());
+  const Storage::WriteStats &stats = Storage::writeStats();
+  fprintf(stderr, "EEPROM: %llu bytes written, waited %.1fms in total and %.1fms at most in one tick, %u late ticks\n",
+      (unsigned long long)stats.numProgrammed, stats.totalStall / 1000.0, stats.maxStall / 1000.0,
+      stats.numLateTicks);
+}
+
+static void print_wear()
+{
+  const Storage::WearStats &wear = Storage::wearStats();
+  if (!wear.numConfigRecords && !wear.numSlotRecords) {
+    fprintf(stderr, "Wear: nothing was saved\n");
+    return;
+  }
+  fprintf(stderr, "Wear: %llu config and %llu slot records saved, the most written byte took %llu writes (%llu saving in place)\n",
+      (unsigned long long)wear.numConfigRecords, (unsigned long long)wear.numSlotRecords,
+      (unsigned long long)wear.maxWrites, (unsigned long long)wear.maxFixedWrites);
+  // nothing was rewritten in place so there is nothing to compare against
+  if (!wear.maxFixedWrites) {
+    return;
   }
-  printf("%s", out.c_str());
-  fflush(stdout);
+  fprintf(stderr, "Wear: the eeprom should last %.1fx as long as saving in place\n", Storage::enduranceGain());
 }
 
 // installed as an automatic exit handler to restore terminal behaviour
@@ -473,73 +1055,6 @@ static void set_terminal_nonblocking()
   atexit(restore_terminal);
 }
 
-bool writeBMP(const std::string& filename, const std::vector<RGBColor>& colors)
-{
-  if (colors.empty()) {
-    std::cerr << "Invalid image dimensions or empty color array." << std::endl;
-    return false;
-  }
-  // need structure alignment for BMP header structures
-#pragma pack(push, 1)
-  // just putting these here because they are directly relevant to this function
-  // and not used anywhere else in the code, if they get used more then just pull
-  // this all out into it's own file based on BMP writing
-  struct BMPHeader {
-    char signature[2];
-    uint32_t fileSize;
-    uint32_t reserved;
-    uint32_t dataOffset;
-  };
-  struct DIBHeader {
-    uint32_t headerSize;
-    int32_t width;
-    int32_t height;
-    uint16_t planes;
-    uint16_t bitsPerPixel;
-    uint32_t compression;
-    uint32_t imageSize;
-    int32_t xPixelsPerMeter;
-    int32_t yPixelsPerMeter;
-    uint32_t colorsInColorTable;
-    uint32_t importantColorCount;
-  };
-#pragma pack(pop)
-  const int32_t width = colors.size();
-  const int32_t height = 1;
-  // rows are padded to the nearest multiple of 4 bytes
-  const uint32_t rowPaddedSize = (width * 3 + 3) & ~3;
-  const uint32_t imageSize = rowPaddedSize * height;
-  const uint32_t fileSize = 54 + imageSize;
-  // BMP header (14 bytes) + DIB header (40 bytes) + image data
-  BMPHeader bmpHeader = {{'B', 'M'}, fileSize, 0, 54};
-  DIBHeader dibHeader = {40, width, height, 1, 24, 0, imageSize, 2835, 2835, 0, 0};
-  // open the file
-  std::ofstream file(filename, std::ios::binary);
-  if (!file) {
-    std::cerr << "Failed to open file: " << filename << " (" << strerror(errno) << ")" << std::endl;
-    return false;
-  }
-  // write out the headers
-  file.write((const char *)&bmpHeader, sizeof(bmpHeader));
-  file.write((const char *)&dibHeader, sizeof(dibHeader));
-  // write out data
-  for (int32_t y = height - 1; y >= 0; --y) {
-    for (int32_t x = 0; x < width; ++x) {
-      const RGBColor& color = colors[y * width + x];
-      // BGR format
-      const unsigned char pixel[3] = { color.blue, color.green, color.red };
-      file.write((const char *)pixel, 3);
-    }
-    // write out extra padding bytes at end of row
-    file.write("\0\0\0", rowPaddedSize - (width * 3));
-  }
-  if (!file.good()) {
-    std::cerr << "Error writing to file: " << filename << std::endl;
-    return false;
-  }
-  return true;
-}
-
 // print out the usage for the tool
 static void print_usage(const char* program_name)
 {
@@ -548,13 +1063,29 @@ static void print_usage(const char* program_name)
   fprintf(stderr, "  -x, --hex                Print hex values to represent led colors instead of color codes\n");
   fprintf(stderr, "  -c, --color              Print console color codes to represent led colors\n");
   fprintf(stderr, "  -q, --quiet              Do not print anything, silently perform an operation\n");
+  fprintf(stderr, "  -W, --raw [fd]           Write packed 3 byte RGB frames to stdout or the file descriptor fd\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Engine Control Flags (optional):\n");
   fprintf(stderr, "  -l, --lockstep           Only step once each time an input is received\n");
+  fprintf(stderr, "  -T, --tickless           Jump between events and print each frame once with its tick count\n");
+  fprintf(stderr, "  -r, --rle                Print each run of identical frames once with its tick count\n");
+  fprintf(stderr, "  -X, --timeline           Play patterns from a compiled timeline instead of the state machine\n");
+  fprintf(stderr, "  -N, --no-timeline        Play patterns with the state machine (default)\n");
   fprintf(stderr, "  -t, --no-timestep        Run as fast as possible without managing timestep\n");
+  fprintf(stderr, "  -U, --spin               Busy wait between ticks instead of sleeping, burns a whole core\n");
+  fprintf(stderr, "  -J, --jitter             Print how late the ticks ran compared to the timestep at the end\n");
   fprintf(stderr, "  -i, --in-place           Print the output in-place (interactive mode)\n");
+  fprintf(stderr, "  -f, --fps <N>            Frames per second of the in-place display (default: %u, 0 shows every tick)\n", DEFAULT_DISPLAY_FPS);
+  fprintf(stderr, "  -v, --pov                Show the average of the ticks in each in-place frame instead of the last\n");
   fprintf(stderr, "  -s, --storage            Enable persistent storage to file (" STORAGE_FILENAME ")\n");
-  fprintf(stderr, "  -y, --cycle [N]          Run N cycles of the first mode, default 1 (to gen pattern images)\n");
+  fprintf(stderr, "  -Z, --storage-stats      Print the storage reads, writes, flushes and eeprom wait time at the end\n");
+  fprintf(stderr, "  -Y, --sync-storage       Model eeprom writes that wait on every byte instead of the write queue\n");
+  fprintf(stderr, "  -w, --wear               Print how much the saves wore the eeprom and the endurance gain at the end\n");
+  fprintf(stderr, "  -y, --cycle [N]          Run exactly N periods of the first mode, default 1 (to gen pattern images)\n");
+  fprintf(stderr, "  -R, --render-cache <dir> Serve --cycle renders of the pattern alone from a cache saved in dir\n");
+  fprintf(stderr, "  -k, --ticks <N>          Stop after N ticks\n");
+  fprintf(stderr, "  -e, --every <N>          Only output every Nth tick\n");
+  fprintf(stderr, "  -D, --digest             Run without any output then print a hash of the led output and the final state\n");
   fprintf(stderr, "  -a, --brightness-scale   Set the brightness scale of the output colors (default: 1.0, 2.0 is 100%% brighter)\n");
   fprintf(stderr, "  -m, --min-brightness     Set the minimum brightness the output colors can be (default: 75)\n");
   fprintf(stderr, "\n");
@@ -563,13 +1094,26 @@ static void print_usage(const char* program_name)
   fprintf(stderr, "  -P, --pattern            Set the pattern of the first mode, ex: 1 or blend\n");
   fprintf(stderr, "  -A, --pattern-args       Set the pattern args of the first mode, ex: 1,2,3 or 1,2,3,4,5\n");
   fprintf(stderr, "  -I, --mode-index         Set the initial mode index, ex 4\n");
+  fprintf(stderr, "  -K, --seek <ticks>       Start the first mode this many ticks into the pattern\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Other Options:\n");
   fprintf(stderr, "  -b, --bmp [file]         Specify a bitmap file to generate (default: " DEFAULT_BMP_FILENAME ")\n");
+  fprintf(stderr, "  -g, --png [file]         Specify a png file to generate (default: " DEFAULT_PNG_FILENAME ")\n");
   fprintf(stderr, "  -E, --eeprom             Generate an eeprom file for flashing\n");
   fprintf(stderr, "  -S, --parse-save <file>  Parse an eeprom storage dump (supports .eep, .csv, and .storage formats)\n");
+  fprintf(stderr, "  -n, --input-file <file>  Read the input commands from a script file instead of stdin, can be repeated\n");
+  fprintf(stderr, "  -O, --record <file>      Record the inputs and led output to a binary trace (see trace.h)\n");
+  fprintf(stderr, "  -L, --replay <file>      Replay a binary trace on a fresh device instead of reading inputs\n");
+  fprintf(stderr, "  -V, --verify             Check the led output of --replay against the trace\n");
   fprintf(stderr, "  -h, --help               Display this help message\n");
   fprintf(stderr, "\n");
+  fprintf(stderr, "Device Farm:\n");
+  fprintf(stderr, "  -F, --farm <joblist>     Run every job in the list on parallel simulated devices (see farm.h)\n");
+  fprintf(stderr, "  -G, --gallery <dir>      Render a png and svg of every pattern in dir and the built in patterns\n");
+  fprintf(stderr, "  -M, --batch <manifest>   Render every job in the manifest, - for stdin (see render_batch.h)\n");
+  fprintf(stderr, "  -j, --threads <N>        Number of farm, gallery or batch threads (default: one per core)\n");
+  fprintf(stderr, "  -B, --bench-batch <N>    Time N patterns played one by one against a pattern batch\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "Input Commands (pass to stdin):");
   const char *input_usage[] = {
     "\n   c         standard short click",
@@ -591,6 +1135,8 @@ static void print_usage(const char* program_name)
   fprintf(stderr, "   ./helios -ci\n");
   fprintf(stderr, "   ./helios -cl <<< 300wcw300wcp1500wr300wq\n");
   fprintf(stderr, "   ./helios -S eeprom_dump.eep\n");
+  fprintf(stderr, "   ./helios -xT <<< 300wcw300wcp1500wr300wq\n");
+  fprintf(stderr, "   ./helios -F jobs.txt -j 8\n");
 }
 
 static bool parse_eep_file(const std::string& filename, std::vector<uint8_t>& memory)
@@ -655,7 +1201,7 @@ static bool parse_csv_hex(const std::string& filename, std::vector<uint8_t>& mem
   std::string token;
 
   uint32_t pos = 0;
-  while (std::getline(iss, token, ',') && pos < EEPROM_SIZE) {
+  while (std::getline(iss, token, ',') && pos < STORAGE_SIZE) {
     // Remove leading/trailing whitespace and "0x" prefix if present
     token.erase(0, token.find_first_not_of(" \t"));
     token.erase(token.find_last_not_of(" \t") + 1);
@@ -694,7 +1240,7 @@ static void dump_eeprom(const std::string& filename)
     printf("Must provide an eeprom filename\n");
     return;
   }
-  std::vector<uint8_t> memory(EEPROM_SIZE, 0xFF); // Initialize memory with 0xFF
+  std::vector<uint8_t> memory(STORAGE_SIZE, 0xFF); // Initialize memory with 0xFF
   // Get file extension as lowercase
   std::string extension = filename.substr(filename.find_last_of(".") + 1);
   std::transform(extension.begin(), extension.end(), extension.begin(),
@@ -714,13 +1260,18 @@ static void dump_eeprom(const std::string& filename)
     printf("Failed to parse file\n");
     return;
   }
-  for (size_t slot = 0; slot < NUM_MODE_SLOTS; ++slot) {
-    size_t pos = slot * SLOT_SIZE;
-
+  // find the newest records in the dump the same way the device does
+  Storage::enableStorage(true);
+  Storage::setStorageImage(memory.data());
+  Storage::init();
+  for (uint8_t slot = 0; slot < NUM_MODE_SLOTS; ++slot) {
     Pattern pat;
-    memcpy((void*)&pat, &memory[pos], sizeof(Pattern));
+    if (!Storage::read_pattern(slot, pat)) {
+      printf("Slot %u: empty\n", slot);
+      continue;
+    }
 
-    printf("Slot %zu:\n", slot);
+    printf("Slot %u:\n", slot);
     printf("  Colorset: ");
     for (size_t i = 0; i < pat.getColorset().numColors(); ++i) {
       RGBColor color = pat.getColorset()[i];
@@ -736,11 +1287,11 @@ static void dump_eeprom(const std::string& filename)
     printf("  Flags: %02X\n", pat.getFlags());
   }
 
-  uint8_t flags = (uint8_t)memory[CONFIG_START_INDEX - STORAGE_GLOBAL_FLAG_INDEX];
+  uint8_t flags = Storage::read_global_flags();
   bool locked = (flags & Helios::FLAG_LOCKED) != 0;
   bool conjure = (flags & Helios::FLAG_CONJURE) != 0;
-  uint8_t modeIdx = (uint8_t)memory[CONFIG_START_INDEX - STORAGE_CURRENT_MODE_INDEX];
-  uint8_t brightness = (uint8_t)memory[CONFIG_START_INDEX - STORAGE_BRIGHTNESS_INDEX];
+  uint8_t modeIdx = Storage::read_current_mode();
+  uint8_t brightness = Storage::read_brightness();
 
   printf("Brightness: %u\n", brightness);
   printf("Mode Index: %u\n", modeIdx);
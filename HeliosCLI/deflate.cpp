@@ -0,0 +1,280 @@
+#include <string.h>
+
+#include "deflate.h"
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+// matches can't reach this close to the window size because the chains of
+// the oldest positions have been overwritten by then
+#define MAX_DIST (DEFLATE_WINDOW - MAX_MATCH - MIN_MATCH - 1)
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+// the number of older positions checked for a longer match
+#define MAX_CHAIN 32
+// a match this long is good enough to stop looking for a longer one
+#define NICE_MATCH 128
+// the positions inside a match longer than this aren't added to the hash
+// chains, the long runs of one color are nearly all matches so this saves
+// hashing almost every byte
+#define MAX_INSERT 16
+// the history is kept in a buffer this many windows long so the older data
+// only has to be slid out of the way now and then
+#define WINDOW_BUFFERS 4
+#define ADLER_MOD 65521
+
+// the first length of each length code starting from code 257, and the
+// number of extra bits that follow it
+static const uint16_t length_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+// the same for the distance codes
+static const uint16_t dist_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// huffman codes go out most significant bit first but the stream is filled
+// from the lowest bit, so the codes are written reversed
+static uint32_t reverse_bits(uint32_t code, uint32_t count)
+{
+  uint32_t reversed = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    reversed = (reversed << 1) | ((code >> i) & 1);
+  }
+  return reversed;
+}
+
+static uint32_t hash_bytes(const uint8_t *data)
+{
+  return (((uint32_t)data[0] << 10) ^ ((uint32_t)data[1] << 5) ^ data[2]) & (HASH_SIZE - 1);
+}
+
+Deflater::Deflater() :
+  m_window(DEFLATE_WINDOW * WINDOW_BUFFERS),
+  m_pos(0),
+  m_end(0),
+  m_head(HASH_SIZE, -1),
+  m_prev(DEFLATE_WINDOW, -1),
+  m_bitBuf(0),
+  m_bitCount(0),
+  m_adlerA(1),
+  m_adlerB(0),
+  m_started(false)
+{
+}
+
+void Deflater::write(const uint8_t *data, size_t len, std::string &out)
+{
+  if (!m_started) {
+    // zlib header: deflate with a 32K window and the default level
+    out.push_back((char)0x78);
+    out.push_back((char)0x01);
+    // every block but the final one is a fixed huffman block that never ends
+    putBits(0, 1, out);
+    putBits(1, 2, out);
+    m_started = true;
+  }
+  while (len > 0) {
+    if (m_end == m_window.size()) {
+      compress(false, out);
+      slide();
+    }
+    size_t chunk = m_window.size() - m_end;
+    if (chunk > len) {
+      chunk = len;
+    }
+    memcpy(m_window.data() + m_end, data, chunk);
+    // the checksum is done in pieces small enough that it can't overflow
+    for (size_t i = 0; i < chunk; i += 5552) {
+      size_t n = (chunk - i < 5552) ? chunk - i : 5552;
+      for (size_t j = 0; j < n; ++j) {
+        m_adlerA += data[i + j];
+        m_adlerB += m_adlerA;
+      }
+      m_adlerA %= ADLER_MOD;
+      m_adlerB %= ADLER_MOD;
+    }
+    m_end += (uint32_t)chunk;
+    data += chunk;
+    len -= chunk;
+  }
+  compress(false, out);
+}
+
+void Deflater::finish(std::string &out)
+{
+  if (!m_started) {
+    write(nullptr, 0, out);
+  }
+  compress(true, out);
+  // end the open block then add an empty final block
+  putLiteral(256, out);
+  putBits(1, 1, out);
+  putBits(1, 2, out);
+  putLiteral(256, out);
+  if (m_bitCount > 0) {
+    putBits(0, 8 - m_bitCount, out);
+  }
+  uint32_t adler = (m_adlerB << 16) | m_adlerA;
+  out.push_back((char)(adler >> 24));
+  out.push_back((char)(adler >> 16));
+  out.push_back((char)(adler >> 8));
+  out.push_back((char)adler);
+}
+
+void Deflater::compress(bool flush, std::string &out)
+{
+  uint32_t limit = flush ? m_end : ((m_end > MAX_MATCH) ? m_end - MAX_MATCH : 0);
+  while (m_pos < limit) {
+    uint32_t dist = 0;
+    uint32_t len = findMatch(m_pos, dist);
+    if (len < MIN_MATCH) {
+      insert(m_pos);
+      putLiteral(m_window[m_pos], out);
+      m_pos++;
+      continue;
+    }
+    putMatch(len, dist, out);
+    if (len <= MAX_INSERT) {
+      for (uint32_t i = 0; i < len; ++i) {
+        insert(m_pos + i);
+      }
+    } else {
+      insert(m_pos);
+    }
+    m_pos += len;
+  }
+}
+
+void Deflater::slide()
+{
+  // keep one window of history and drop everything before it
+  const int32_t shift = (int32_t)(m_window.size() - DEFLATE_WINDOW);
+  memmove(m_window.data(), m_window.data() + shift, m_end - shift);
+  m_pos -= shift;
+  m_end -= shift;
+  for (size_t i = 0; i < m_head.size(); ++i) {
+    m_head[i] = (m_head[i] >= shift) ? m_head[i] - shift : -1;
+  }
+  for (size_t i = 0; i < m_prev.size(); ++i) {
+    m_prev[i] = (m_prev[i] >= shift) ? m_prev[i] - shift : -1;
+  }
+}
+
+void Deflater::insert(uint32_t pos)
+{
+  if (pos + MIN_MATCH > m_end) {
+    return;
+  }
+  uint32_t hash = hash_bytes(m_window.data() + pos);
+  m_prev[pos & (DEFLATE_WINDOW - 1)] = m_head[hash];
+  m_head[hash] = (int32_t)pos;
+}
+
+uint32_t Deflater::findMatch(uint32_t pos, uint32_t &dist) const
+{
+  if (pos + MIN_MATCH > m_end) {
+    return 0;
+  }
+  const uint8_t *cur = m_window.data() + pos;
+  uint32_t maxLen = m_end - pos;
+  if (maxLen > MAX_MATCH) {
+    maxLen = MAX_MATCH;
+  }
+  uint32_t bestLen = 0;
+  int32_t cand = m_head[hash_bytes(cur)];
+  for (uint32_t chain = 0; chain < MAX_CHAIN && cand >= 0; ++chain) {
+    if (pos - (uint32_t)cand > MAX_DIST) {
+      break;
+    }
+    const uint8_t *prev = m_window.data() + cand;
+    if (prev[bestLen] == cur[bestLen]) {
+      uint32_t len = matchLength(prev, cur, maxLen);
+      if (len > bestLen) {
+        bestLen = len;
+        dist = pos - (uint32_t)cand;
+        if (len >= NICE_MATCH || len == maxLen) {
+          break;
+        }
+      }
+    }
+    int32_t next = m_prev[cand & (DEFLATE_WINDOW - 1)];
+    // the chains only ever go back in time
+    if (next >= cand) {
+      break;
+    }
+    cand = next;
+  }
+  return (bestLen >= MIN_MATCH) ? bestLen : 0;
+}
+
+uint32_t Deflater::matchLength(const uint8_t *prev, const uint8_t *cur, uint32_t maxLen)
+{
+  uint32_t len = 0;
+  // eight bytes at a time until they differ
+  while (len + 8 <= maxLen) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, prev + len, sizeof(a));
+    memcpy(&b, cur + len, sizeof(b));
+    if (a != b) {
+      break;
+    }
+    len += 8;
+  }
+  while (len < maxLen && prev[len] == cur[len]) {
+    len++;
+  }
+  return len;
+}
+
+void Deflater::putBits(uint32_t bits, uint32_t count, std::string &out)
+{
+  m_bitBuf |= bits << m_bitCount;
+  m_bitCount += count;
+  while (m_bitCount >= 8) {
+    out.push_back((char)(m_bitBuf & 0xFF));
+    m_bitBuf >>= 8;
+    m_bitCount -= 8;
+  }
+}
+
+void Deflater::putLiteral(uint32_t lit, std::string &out)
+{
+  // the fixed literal/length code
+  if (lit < 144) {
+    putBits(reverse_bits(0x30 + lit, 8), 8, out);
+  } else if (lit < 256) {
+    putBits(reverse_bits(0x190 + (lit - 144), 9), 9, out);
+  } else if (lit < 280) {
+    putBits(reverse_bits(lit - 256, 7), 7, out);
+  } else {
+    putBits(reverse_bits(0xC0 + (lit - 280), 8), 8, out);
+  }
+}
+
+void Deflater::putMatch(uint32_t len, uint32_t dist, std::string &out)
+{
+  uint32_t code = 28;
+  while (length_base[code] > len) {
+    code--;
+  }
+  putLiteral(257 + code, out);
+  putBits(len - length_base[code], length_extra[code], out);
+  code = 29;
+  while (dist_base[code] > dist) {
+    code--;
+  }
+  // the fixed distance codes are all five bits
+  putBits(reverse_bits(code, 5), 5, out);
+  putBits(dist - dist_base[code], dist_extra[code], out);
+}
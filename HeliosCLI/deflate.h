@@ -0,0 +1,65 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// the size of the history matches can reach back into
+#define DEFLATE_WINDOW 32768
+
+// A streaming zlib (RFC 1950) compressor for the PNG writer.
+//
+// The data is compressed with LZ77 using hash chains and coded with the fixed
+// Huffman codes of deflate (RFC 1951), the dynamic codes would only shave a
+// little more off. LED output is long runs of the same few colors so nearly
+// all of it becomes back references, a run of one color is a single match
+// three bytes back repeated every 258 bytes.
+//
+// Memory use is fixed no matter how much data goes through, the compressed
+// bytes are appended to the caller's string as they are produced.
+class Deflater
+{
+public:
+  Deflater();
+
+  // compress some more data
+  void write(const uint8_t *data, size_t len, std::string &out);
+  // compress whatever is left and end the stream
+  void finish(std::string &out);
+
+private:
+  // code the buffered data, all of it with flush or otherwise leaving enough
+  // lookahead for a full length match
+  void compress(bool flush, std::string &out);
+  // drop the older half of the window to make room
+  void slide();
+  // add the three bytes at a position to the hash chains
+  void insert(uint32_t pos);
+  // the longest match for a position, returns the length or 0
+  uint32_t findMatch(uint32_t pos, uint32_t &dist) const;
+  // the number of bytes that are the same at the start of both
+  static uint32_t matchLength(const uint8_t *prev, const uint8_t *cur, uint32_t maxLen);
+
+  void putBits(uint32_t bits, uint32_t count, std::string &out);
+  void putLiteral(uint32_t lit, std::string &out);
+  void putMatch(uint32_t len, uint32_t dist, std::string &out);
+
+  // the history and lookahead, a few windows long so it only slides now and then
+  std::vector<uint8_t> m_window;
+  uint32_t m_pos;
+  uint32_t m_end;
+  // the most recent position for each hash and the one before each position
+  std::vector<int32_t> m_head;
+  std::vector<int32_t> m_prev;
+  // bits waiting to fill a byte, lowest bit first
+  uint32_t m_bitBuf;
+  uint32_t m_bitCount;
+  // the checksum of the uncompressed data
+  uint32_t m_adlerA;
+  uint32_t m_adlerB;
+  bool m_started;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "HeliosEngine.h"
+#include "Helios.h"
+#include "Colorset.h"
+#include "Pattern.h"
+
+#include "device_config.h"
+#include "color_map.h"
+
+void apply_device_config(const DeviceConfig &config)
+{
+  // set the initial mode index
+  Helios::set_mode_index(config.mode_index);
+  // Set the initial pattern based on user arguments
+  if (config.pattern.length() > 0) {
+    // convert the string arg to integer, then treat it as a PatternID
+    PatternID id = (PatternID)strtoul(config.pattern.c_str(), NULL, 10);
+    // pass the current pattern to make_pattern to update it's internals
+    Patterns::make_pattern(id, Helios::cur_pattern());
+    // re-initialize the current pattern
+    Helios::cur_pattern().init();
+  }
+  // set initial pattern args based on user arguments
+  if (config.pattern_args.length() > 0) {
+    // parse the list of args into an array of ints
+    std::vector<uint32_t> vals;
+    std::istringstream ss(config.pattern_args);
+    // push 6 args into the array
+    while (vals.size() < 6) {
+      std::string arg;
+      uint32_t val = 0;
+      // try to parse out a number
+      if (std::getline(ss, arg, ',')) {
+        val = strtoul(arg.c_str(), NULL, 10);
+      }
+      // push the val either 0 or parsed number
+      vals.push_back(val);
+    }
+    // construct pattern args from the array of values
+    PatternArgs args(vals[0], vals[1], vals[2], vals[3], vals[4], vals[5]);
+    // set the args of the current pattern
+    Helios::cur_pattern().setArgs(args);
+  }
+  // Set the initial colorset based on user arguments
+  if (config.colorset.length() > 0) {
+    std::stringstream ss(config.colorset);
+    std::string color;
+    Colorset set;
+    while (getline(ss, color, ',')) {
+      // iterate letters and lowercase them
+      std::transform(color.begin(), color.end(), color.begin(), [](unsigned char c){ return tolower(c); });
+      // this can run on many threads at once so only look up the map
+      std::map<std::string, uint32_t>::const_iterator it = color_map.find(color);
+      if (it != color_map.end()) {
+        set.addColor(it->second);
+      } else {
+        set.addColor(strtoul(color.c_str(), nullptr, 16));
+      }
+    }
+    // update the colorset of the current pattern
+    Helios::cur_pattern().setColorset(set);
+    // re-initialize the current pattern
+    Helios::cur_pattern().init();
+  }
+  // fast forward the pattern to start part way through
+  if (config.seek > 0) {
+    Helios::cur_pattern().seek(config.seek);
+  }
+}
+
+Pattern config_pattern(const DeviceConfig &config)
+{
+  HeliosEngine engine;
+  engine.enableStorage(false);
+  engine.bind();
+  Helios::init();
+  apply_device_config(config);
+  Pattern pat(Helios::cur_pattern());
+  engine.unbind();
+  return pat;
+}
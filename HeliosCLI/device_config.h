@@ -0,0 +1,32 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <inttypes.h>
+#include <string>
+
+#include "Pattern.h"
+
+// The initial setup of a simulated device, these are the same settings
+// the CLI takes with --colorset, --pattern, --pattern-args, --mode-index
+// and --seek
+struct DeviceConfig
+{
+  DeviceConfig() :
+    colorset(), pattern(), pattern_args(), mode_index(0), seek(0) {}
+
+  std::string colorset;
+  std::string pattern;
+  std::string pattern_args;
+  uint32_t mode_index;
+  uint32_t seek;
+};
+
+// apply the config to the device currently in the engine globals, this
+// must run after Helios::init() (or with the HeliosEngine bound after init)
+void apply_device_config(const DeviceConfig &config);
+
+// the pattern of the first mode of a fresh device with the config applied,
+// the device is set up on an engine of it's own so this can run on any thread
+Pattern config_pattern(const DeviceConfig &config);
+
+#endif
@@ -0,0 +1,489 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <map>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "HeliosEngine.h"
+#include "Helios.h"
+#include "Button.h"
+#include "Led.h"
+
+#include "device_config.h"
+#include "work_pool.h"
+#include "led_digest.h"
+#include "farm.h"
+
+// the size of the buffer used to write each job output file
+#define FARM_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+// a single simulated device in the farm and the results of running it
+struct FarmJob
+{
+  FarmJob() :
+    name(), config(), brightness_scale(1.0f), storage(false), input(),
+    max_ticks(0), output(), ticks(0), frames(0), digest(0), wall_ms(0),
+    success(false) {}
+
+  // the job description
+  std::string name;
+  DeviceConfig config;
+  float brightness_scale;
+  bool storage;
+  std::string input;
+  uint32_t max_ticks;
+  std::string output;
+
+  // the results
+  uint64_t ticks;
+  uint64_t frames;
+  uint64_t digest;
+  double wall_ms;
+  bool success;
+};
+
+// parse one line of the job list, returns false if the line is malformed
+static bool parse_job(const std::string &line, uint32_t lineNum, FarmJob &job)
+{
+  std::istringstream ss(line);
+  std::string field;
+  job.name = std::to_string(lineNum);
+  while (ss >> field) {
+    size_t eq = field.find('=');
+    if (eq == std::string::npos) {
+      fprintf(stderr, "Job list line %u: expected key=value but got '%s'\n", lineNum, field.c_str());
+      return false;
+    }
+    std::string key = field.substr(0, eq);
+    std::string val = field.substr(eq + 1);
+    if (key == "name") {
+      job.name = val;
+    } else if (key == "colorset") {
+      job.config.colorset = val;
+    } else if (key == "pattern") {
+      job.config.pattern = val;
+    } else if (key == "pattern-args") {
+      job.config.pattern_args = val;
+    } else if (key == "mode-index") {
+      job.config.mode_index = strtoul(val.c_str(), NULL, 10);
+    } else if (key == "seek") {
+      job.config.seek = strtoul(val.c_str(), NULL, 10);
+    } else if (key == "brightness") {
+      job.brightness_scale = strtof(val.c_str(), NULL);
+      if (!job.brightness_scale) {
+        job.brightness_scale = 1.0f;
+      }
+    } else if (key == "storage") {
+      job.storage = (strtoul(val.c_str(), NULL, 10) != 0);
+    } else if (key == "input") {
+      job.input = val;
+    } else if (key == "ticks") {
+      job.max_ticks = strtoul(val.c_str(), NULL, 10);
+    } else if (key == "output") {
+      job.output = val;
+    } else {
+      fprintf(stderr, "Job list line %u: unknown field '%s'\n", lineNum, key.c_str());
+      return false;
+    }
+  }
+  // a device only stops when it is told to quit or runs out of ticks
+  if (!job.max_ticks && job.input.find('q') == std::string::npos) {
+    fprintf(stderr, "Job list line %u: job never ends, add ticks=N or a q input\n", lineNum);
+    return false;
+  }
+  return true;
+}
+
+static bool load_jobs(const std::string &joblist, std::vector<FarmJob> &jobs)
+{
+  std::ifstream file(joblist);
+  if (!file.is_open()) {
+    fprintf(stderr, "Failed to open job list: %s\n", joblist.c_str());
+    return false;
+  }
+  std::string line;
+  uint32_t lineNum = 0;
+  while (std::getline(file, line)) {
+    lineNum++;
+    // strip windows line endings and skip blank lines or comments
+    if (line.length() && line[line.length() - 1] == '\r') {
+      line.erase(line.length() - 1);
+    }
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+    FarmJob job;
+    if (!parse_job(line, lineNum, job)) {
+      return false;
+    }
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+// the state of a simulated device part way through it's input, every job
+// whose input starts the same way carries on from a copy of this instead
+// of simulating the same ticks again
+struct FarmFork
+{
+  FarmFork() : engine(), ticks(0), frames(0), digest(FNV_OFFSET_BASIS), output(),
+    runColor(), runLength(0) {}
+
+  HeliosEngine engine;
+  uint64_t ticks;
+  uint64_t frames;
+  uint64_t digest;
+  // the finished runs of led output so far in --hex --rle format, only if
+  // the jobs want it, and the run that is still going
+  std::string output;
+  RGBColor runColor;
+  uint32_t runLength;
+};
+
+// the input of a job as runs of repeated commands, a long wait is a single
+// run so it costs the same as a short one
+typedef std::vector<Button::InputRun> FarmRuns;
+
+// a job along with it's input
+typedef std::pair<FarmRuns, FarmJob *> FarmInput;
+
+// a node in the tree of shared input prefixes, a node runs the inputs from
+// the end of it's parent up to it's depth then forks into it's children, a
+// node without any children finishes the job. The depth counts every repeat
+// so two jobs can part ways in the middle of a run
+struct FarmNode
+{
+  FarmNode() : depth(0), input(NULL), children() {}
+
+  uint64_t depth;
+  // any of the jobs below this node, they all share the same prefix
+  const FarmInput *input;
+  std::vector<FarmNode> children;
+};
+
+// the number of ticks that were actually simulated, any tick in a shared
+// prefix is only simulated once no matter how many jobs it counts towards
+static std::atomic<uint64_t> simulated_ticks(0);
+
+// whether every input is a command that gets used up in a single tick,
+// anything else gets stuck in the queue so it can't be shared
+static bool is_shareable(const FarmRuns &runs)
+{
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (!strchr("wcplrtq", runs[i].command)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the total number of inputs in the runs
+static uint64_t num_inputs(const FarmRuns &runs)
+{
+  uint64_t total = 0;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    total += runs[i].count;
+  }
+  return total;
+}
+
+// the input at a position that counts every repeat
+static char input_at(const FarmRuns &runs, uint64_t pos)
+{
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (pos < runs[i].count) {
+      return runs[i].command;
+    }
+    pos -= runs[i].count;
+  }
+  return 0;
+}
+
+// the number of inputs two sets of runs start with in common, and whether
+// the first would sort before the second if every repeat was written out
+static uint64_t common_inputs(const FarmRuns &a, const FarmRuns &b, bool *less = NULL)
+{
+  uint64_t common = 0;
+  size_t i = 0;
+  size_t j = 0;
+  // the inputs of the current run of each that are still left
+  uint64_t leftA = a.size() ? a[0].count : 0;
+  uint64_t leftB = b.size() ? b[0].count : 0;
+  while (i < a.size() && j < b.size() && a[i].command == b[j].command) {
+    uint64_t step = std::min(leftA, leftB);
+    common += step;
+    leftA -= step;
+    leftB -= step;
+    if (!leftA && ++i < a.size()) {
+      leftA = a[i].count;
+    }
+    if (!leftB && ++j < b.size()) {
+      leftB = b[j].count;
+    }
+  }
+  if (less) {
+    // an input that ends first sorts first
+    *less = (j < b.size()) && (i >= a.size() || a[i].command < b[j].command);
+  }
+  return common;
+}
+
+static bool sort_inputs(const FarmInput &a, const FarmInput &b)
+{
+  bool less = false;
+  common_inputs(a.first, b.first, &less);
+  if (less) {
+    return true;
+  }
+  common_inputs(b.first, a.first, &less);
+  // identical inputs stay in the order of the job list
+  return !less && a.second < b.second;
+}
+
+// queue the inputs between two positions that count every repeat, a run
+// that only partly falls between them is cut down to the part that does
+static void queue_runs(const FarmRuns &runs, uint64_t from, uint64_t to)
+{
+  uint64_t start = 0;
+  for (size_t i = 0; i < runs.size() && start < to; ++i) {
+    uint64_t end = start + runs[i].count;
+    if (end > from) {
+      uint64_t first = std::max(start, from);
+      uint64_t last = std::min(end, to);
+      Button::queueInput(runs[i].command, (uint32_t)(last - first));
+    }
+    start = end;
+  }
+}
+
+// the settings a job starts with, only jobs with the same settings can share
+static std::string job_settings(const FarmJob &job)
+{
+  std::ostringstream ss;
+  ss << job.config.colorset << '|' << job.config.pattern << '|' << job.config.pattern_args << '|'
+     << job.config.mode_index << '|' << job.config.seek << '|' << job.brightness_scale << '|'
+     << job.storage << '|' << job.max_ticks << '|' << !job.output.empty();
+  return ss.str();
+}
+
+// build the tree of a range of sorted inputs that all share at least the
+// first minDepth inputs
+static void build_tree(FarmNode &node, const FarmInput *begin, const FarmInput *end, uint64_t minDepth)
+{
+  node.input = begin;
+  if (end - begin == 1) {
+    node.depth = num_inputs(begin->first);
+    return;
+  }
+  // the inputs are sorted so the first and last have the shortest prefix in common
+  uint64_t depth = std::max(minDepth, common_inputs(begin->first, (end - 1)->first));
+  node.depth = depth;
+  // split the range into groups with the same next input, any input that
+  // ends right here sorts first and finishes on it's own
+  const FarmInput *cur = begin;
+  while (cur < end) {
+    const FarmInput *next = cur + 1;
+    char command = input_at(cur->first, depth);
+    if (command) {
+      while (next < end && input_at(next->first, depth) == command) {
+        next++;
+      }
+    }
+    node.children.push_back(FarmNode());
+    build_tree(node.children.back(), cur, next, depth);
+    cur = next;
+  }
+}
+
+// the very start of every job with the same settings
+static void init_fork(FarmFork &fork, const FarmJob &job)
+{
+  fork.engine.enableStorage(job.storage);
+  fork.engine.bind();
+  Helios::init();
+  apply_device_config(job.config);
+  fork.engine.unbind();
+}
+
+// write the current run of the fork to the file, or keep it in the fork
+static void write_run(FarmFork &fork, FILE *out)
+{
+  if (!fork.runLength) {
+    return;
+  }
+  char line[32];
+  int len = snprintf(line, sizeof(line), "%02X%02X%02X %u\n", fork.runColor.red,
+      fork.runColor.green, fork.runColor.blue, fork.runLength);
+  if (out) {
+    fwrite(line, 1, len, out);
+  } else {
+    fork.output.append(line, len);
+  }
+  fork.runLength = 0;
+}
+
+// run the device of a fork on the calling thread with the inputs of a job
+// between two positions until it quits or runs out of ticks, if untilEmpty is
+// set it also stops the moment it's input runs out so the next input is
+// picked up on the very next tick of a copy
+static void run_fork(FarmFork &fork, const FarmJob &job, const FarmRuns &input,
+  uint64_t from, uint64_t to, bool untilEmpty, FILE *out)
+{
+  bool keepOutput = !out && !job.output.empty();
+  uint64_t startTicks = fork.ticks;
+  // bind the engine for the whole run, nothing else runs on this thread
+  fork.engine.bind();
+  queue_runs(input, from, to);
+  while (Helios::keep_going() && (!job.max_ticks || fork.ticks < job.max_ticks)) {
+    if (untilEmpty && !Button::inputQueueSize()) {
+      break;
+    }
+    Helios::tick();
+    fork.ticks++;
+    // the CLI doesn't show anything while the device is asleep
+    if (Helios::is_asleep()) {
+      continue;
+    }
+    RGBColor col = Led::get().scaleBrightness(job.brightness_scale);
+    fork.digest = digest_color(fork.digest, col);
+    fork.frames++;
+    if (out || keepOutput) {
+      if (fork.runLength > 0 && col == fork.runColor) {
+        fork.runLength++;
+        continue;
+      }
+      write_run(fork, out);
+      fork.runColor = col;
+      fork.runLength = 1;
+    }
+  }
+  fork.engine.unbind();
+  simulated_ticks += fork.ticks - startTicks;
+}
+
+// finish a job from a fork on the calling thread
+static void finish_job(FarmJob &job, FarmFork &fork, const FarmRuns &input, uint64_t from)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  FILE *out = NULL;
+  char *outbuf = NULL;
+  if (job.output.length() > 0) {
+    out = fopen(job.output.c_str(), "wb");
+    if (!out) {
+      perror("Failed to open job output");
+      return;
+    }
+    outbuf = new char[FARM_OUTPUT_BUFFER_SIZE];
+    setvbuf(out, outbuf, _IOFBF, FARM_OUTPUT_BUFFER_SIZE);
+    // the output of the prefix this job shared with others
+    fwrite(fork.output.data(), 1, fork.output.length(), out);
+  }
+  run_fork(fork, job, input, from, UINT64_MAX, false, out);
+  if (out) {
+    write_run(fork, out);
+    fclose(out);
+    delete[] outbuf;
+  }
+  job.ticks = fork.ticks;
+  job.frames = fork.frames;
+  job.digest = fork.digest;
+  job.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  job.success = true;
+}
+
+// run a node of the tree from a copy of the fork it's parent left off at,
+// then hand a fork of this node to each of it's children
+static void run_node(WorkPool &pool, const FarmNode &node, uint64_t parentDepth,
+  std::shared_ptr<const FarmFork> parent)
+{
+  FarmFork fork(*parent);
+  parent.reset();
+  FarmJob &job = *node.input->second;
+  const FarmRuns &input = node.input->first;
+  if (node.children.empty()) {
+    finish_job(job, fork, input, parentDepth);
+    return;
+  }
+  run_fork(fork, job, input, parentDepth, node.depth, true, NULL);
+  std::shared_ptr<const FarmFork> shared(new FarmFork(fork));
+  for (size_t i = 0; i < node.children.size(); ++i) {
+    const FarmNode *child = &node.children[i];
+    uint64_t depth = node.depth;
+    pool.submit([&pool, child, depth, shared](uint32_t worker) { run_node(pool, *child, depth, shared); });
+  }
+}
+
+int run_farm(const std::string &joblist, uint32_t numThreads)
+{
+  std::vector<FarmJob> jobs;
+  if (!load_jobs(joblist, jobs)) {
+    return 1;
+  }
+  // jobs with the same settings share the simulation of any inputs they
+  // start with in common, sorting the inputs lines up the shared prefixes
+  std::map<std::string, std::vector<FarmInput> > groups;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    FarmJob &job = jobs[i];
+    FarmRuns input = HeliosEngine::inputRuns(job.input.c_str());
+    std::string settings = job_settings(job);
+    if (!is_shareable(input)) {
+      settings += "|" + std::to_string(i);
+    }
+    groups[settings].push_back(FarmInput(input, &job));
+  }
+  std::vector<FarmNode> roots;
+  for (std::map<std::string, std::vector<FarmInput> >::iterator it = groups.begin(); it != groups.end(); ++it) {
+    std::vector<FarmInput> &inputs = it->second;
+    std::sort(inputs.begin(), inputs.end(), sort_inputs);
+    roots.push_back(FarmNode());
+    build_tree(roots.back(), inputs.data(), inputs.data() + inputs.size(), 0);
+  }
+  simulated_ticks = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint32_t workers = 0;
+  // the devices play patterns the same way as the thread running the farm
+  bool timeline = Pattern::isTimelineEnabled();
+  {
+    WorkPool pool(numThreads);
+    workers = pool.numWorkers();
+    for (size_t i = 0; i < roots.size(); ++i) {
+      const FarmNode *root = &roots[i];
+      pool.submit([&pool, root, timeline](uint32_t worker) {
+        std::shared_ptr<FarmFork> fork(new FarmFork());
+        fork->engine.enableTimeline(timeline);
+        init_fork(*fork, *root->input->second);
+        run_node(pool, *root, 0, fork);
+      });
+    }
+    pool.wait();
+  }
+  double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  // report every job in the order of the job list
+  uint64_t total_ticks = 0;
+  uint32_t failures = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const FarmJob &job = jobs[i];
+    if (!job.success) {
+      printf("%s: FAILED\n", job.name.c_str());
+      failures++;
+      continue;
+    }
+    printf("%s: ticks=%llu frames=%llu wall=%.3fms digest=%016llx\n", job.name.c_str(),
+        (unsigned long long)job.ticks, (unsigned long long)job.frames, job.wall_ms,
+        (unsigned long long)job.digest);
+    total_ticks += job.ticks;
+  }
+  double ticks_per_sec = elapsed_ms > 0 ? (total_ticks * 1000.0) / elapsed_ms : 0;
+  printf("Farm: %zu jobs on %u threads, %llu ticks (%llu simulated) in %.3fms (%.0f ticks/sec)\n",
+      jobs.size(), workers, (unsigned long long)total_ticks, (unsigned long long)simulated_ticks,
+      elapsed_ms, ticks_per_sec);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <inttypes.h>
+#include <string>
+
+// Run a list of simulated devices in parallel across a work-stealing pool of
+// worker threads, each device is an independent HeliosEngine so thousands of
+// jobs can run in one process. The job list has one job per line made of
+// key=value fields, blank lines and lines starting with # are ignored:
+//
+//   name=lightside colorset=red,blue pattern-args=2,,40 input=5000wq
+//   name=menus storage=1 input=300wcp1500wr300wq output=menus.hex
+//
+// Fields:
+//   name=<str>          name of the job in the report (default: line number)
+//   colorset=<list>     same as --colorset
+//   pattern=<id>        same as --pattern
+//   pattern-args=<list> same as --pattern-args
+//   mode-index=<n>      same as --mode-index
+//   seek=<n>            same as --seek
+//   brightness=<f>      same as --brightness-scale for the output and digest
+//   storage=<0|1>       give the device an in-memory eeprom (default: 0)
+//   input=<cmds>        input commands, same as stdin of the CLI
+//   ticks=<n>           stop after this many ticks (default: run until 'q')
+//   output=<file>       write the led output to a file in --hex --rle format
+//
+// Jobs with the same settings whose inputs begin the same way only simulate
+// that shared prefix once, each job then carries on from a snapshot of the
+// device taken at the end of the prefix. The wall time of a job only counts
+// the ticks it didn't share.
+//
+// Returns the process exit code, non-zero if the job list can't be loaded
+int run_farm(const std::string &joblist, uint32_t numThreads);
+
+#endif
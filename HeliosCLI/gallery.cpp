@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <chrono>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "Patterns.h"
+#include "Pattern.h"
+
+#include "device_config.h"
+#include "image_writer.h"
+#include "render_cache.h"
+#include "work_pool.h"
+#include "gallery.h"
+
+// where the images go
+#define GALLERY_PNG_DIR "circular_patterns_png"
+#define GALLERY_SVG_DIR "circular_patterns_svg"
+#define PATTERN_FILE_EXT ".pattern"
+
+// the number of periods of each pattern that are rendered
+#define GALLERY_CYCLES 2
+
+// the built in patterns are shown with these settings
+#define GENERIC_COLORSET "red,green,blue"
+#define GENERIC_BRIGHTNESS_SCALE 2.0f
+
+// the layout of the rings, every image is the same size and each ring is
+// one frame per degree starting from the top and going clockwise
+#define CANVAS_SIZE 1000
+#define OUTER_RADIUS 450
+#define RING_THICKNESS 50
+#define RING_GAP 25
+#define NUM_RINGS 3
+
+// the edges of the rings are smoothed with a gaussian blur of this radius,
+// made of a number of box blurs the same way PIL does it
+#define BLUR_RADIUS 2.0
+#define BLUR_PASSES 3
+
+// one pattern in the gallery and the results of rendering it
+struct GalleryJob
+{
+  GalleryJob() :
+    name(), config(), brightness_scale(1.0f), wall_ms(0), success(false) {}
+
+  std::string name;
+  DeviceConfig config;
+  float brightness_scale;
+
+  double wall_ms;
+  bool success;
+};
+
+// read the settings out of a pattern file, returns false if it can't be read
+static bool parse_pattern_file(const std::string &filename, GalleryJob &job)
+{
+  std::ifstream file(filename);
+  if (!file) {
+    perror(("Failed to open pattern file " + filename).c_str());
+    return false;
+  }
+  std::string line;
+  std::string pattern;
+  while (std::getline(file, line)) {
+    if (line.length() > 0 && line[line.length() - 1] == '\r') {
+      line.erase(line.length() - 1);
+    }
+    size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, eq);
+    std::string value = line.substr(eq + 1);
+    if (key == "COLOR_SET") {
+      job.config.colorset = value;
+    } else if (key == "PATTERN_ID") {
+      pattern = value;
+    } else if (key == "PATTERN_ARGS") {
+      job.config.pattern_args = value;
+    } else if (key == "BRIGHTNESS_SCALE") {
+      job.brightness_scale = strtof(value.c_str(), NULL);
+    }
+  }
+  // the args are applied to the default pattern instead if there are any
+  if (job.config.pattern_args.empty()) {
+    job.config.pattern = pattern;
+  }
+  return true;
+}
+
+// the names of the pattern files in a directory in sorted order
+static bool list_pattern_files(const std::string &dir, std::vector<std::string> &names)
+{
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    perror(("Failed to open pattern directory " + dir).c_str());
+    return false;
+  }
+  const size_t extLen = sizeof(PATTERN_FILE_EXT) - 1;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != nullptr) {
+    std::string name = entry->d_name;
+    if (name.length() > extLen && name.compare(name.length() - extLen, extLen, PATTERN_FILE_EXT) == 0) {
+      names.push_back(name.substr(0, name.length() - extLen));
+    }
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  return true;
+}
+
+static bool make_dir(const std::string &dir)
+{
+  // it's fine if the directory already exists
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror(("Failed to create directory " + dir).c_str());
+    return false;
+  }
+  return true;
+}
+
+// the bytes in a row of the image
+#define ROW_BYTES (CANVAS_SIZE * 4)
+// the pixels at each end of a row that the blur leaves alone so it never
+// reaches outside the row, it must be at least half the blur kernel and they
+// are always transparent anyway
+#define BLUR_MARGIN 8
+// the blur weights are fixed point with this many fractional bits, a blurred
+// byte has to fit in 16 bits so everything goes through the vector unit
+#define BLUR_WEIGHT_BITS 8
+
+// a run of pixels in a row that all show the same frame
+struct RingSpan
+{
+  RingSpan(uint32_t start, uint16_t length, uint16_t angle) :
+    start(start), length(length), angle(angle) {}
+
+  // the index of the first pixel
+  uint32_t start;
+  uint16_t length;
+  // the frame shown, it's the degrees clockwise from the top
+  uint16_t angle;
+};
+
+// which frame of the render each pixel shows, this is the same for every
+// image so it's worked out once and shared by all of the workers
+struct RingLayout
+{
+  RingLayout() :
+    spans()
+  {
+    const double center = CANVAS_SIZE / 2;
+    for (uint32_t y = 0; y < CANVAS_SIZE; ++y) {
+      double dy = (y + 0.5) - center;
+      for (uint32_t x = 0; x < CANVAS_SIZE; ++x) {
+        double dx = (x + 0.5) - center;
+        double dist = sqrt((dx * dx) + (dy * dy));
+        bool inRing = false;
+        for (uint32_t ring = 0; ring < NUM_RINGS && !inRing; ++ring) {
+          uint32_t outer = OUTER_RADIUS - (ring * (RING_THICKNESS + RING_GAP));
+          inRing = (dist >= outer - RING_THICKNESS && dist < outer);
+        }
+        if (!inRing) {
+          continue;
+        }
+        int32_t angle = (int32_t)floor((atan2(dy, dx) * 180.0 / M_PI) + 90.0);
+        angle = (angle + 360) % 360;
+        uint32_t index = (y * CANVAS_SIZE) + x;
+        // extend the last span if this pixel carries on from it
+        if (spans.size() > 0 && spans.back().start + spans.back().length == index &&
+            spans.back().angle == angle) {
+          spans.back().length++;
+        } else {
+          spans.push_back(RingSpan(index, 1, (uint16_t)angle));
+        }
+      }
+    }
+  }
+  std::vector<RingSpan> spans;
+};
+
+// the images are drawn and blurred in these, each worker keeps it's own
+// so the memory is only set up once
+struct GalleryBuffers
+{
+  GalleryBuffers() :
+    pixels((size_t)CANVAS_SIZE * ROW_BYTES, 0), rows((size_t)CANVAS_SIZE * ROW_BYTES, 0) {}
+
+  std::vector<uint8_t> pixels;
+  // the image after the blur along the rows
+  std::vector<uint8_t> rows;
+};
+
+// the weights of the blur in each direction, the box blurs are convolved
+// together into one kernel so each direction only takes a single pass
+static std::vector<uint16_t> make_blur_kernel()
+{
+  // the box radius that gives the passes the same spread as the gaussian,
+  // it falls between whole pixels so the pixels at each end count partly
+  double sigma2 = (BLUR_RADIUS * BLUR_RADIUS) / BLUR_PASSES;
+  double whole = floor((sqrt((12 * sigma2) + 1) - 1) / 2);
+  double a = ((2 * whole) + 1) * ((whole * (whole + 1)) - (3 * sigma2));
+  double b = 6 * (sigma2 - ((whole + 1) * (whole + 1)));
+  double radius = whole + (a / b);
+  std::vector<double> box((size_t)(2 * whole) + 3, 1.0 / ((2 * radius) + 1));
+  box.front() = box.back() = (radius - whole) / ((2 * radius) + 1);
+  std::vector<double> kernel(1, 1.0);
+  for (uint32_t pass = 0; pass < BLUR_PASSES; ++pass) {
+    std::vector<double> next(kernel.size() + box.size() - 1, 0.0);
+    for (size_t i = 0; i < kernel.size(); ++i) {
+      for (size_t j = 0; j < box.size(); ++j) {
+        next[i + j] += kernel[i] * box[j];
+      }
+    }
+    kernel.swap(next);
+  }
+  std::vector<uint16_t> weights(kernel.size());
+  int32_t total = 0;
+  for (size_t i = 0; i < kernel.size(); ++i) {
+    weights[i] = (uint16_t)((kernel[i] * (1 << BLUR_WEIGHT_BITS)) + 0.5);
+    total += weights[i];
+  }
+  // whatever was lost to rounding goes in the middle so a flat area
+  // comes out exactly the same as it went in
+  weights[kernel.size() / 2] += (1 << BLUR_WEIGHT_BITS) - total;
+  return weights;
+}
+
+// draw the first frames of the render around the rings, black is left
+// transparent so only the colors show
+static void draw_rings(std::vector<uint8_t> &pixels, const RenderCache::Frames &frames)
+{
+  // built the first time it's needed, this is safe across threads
+  static const RingLayout layout;
+  memset(pixels.data(), 0, pixels.size());
+  if (frames.empty()) {
+    return;
+  }
+  for (size_t i = 0; i < layout.spans.size(); ++i) {
+    const RingSpan &span = layout.spans[i];
+    const RGBColor &col = frames[span.angle % frames.size()];
+    if (col.empty()) {
+      continue;
+    }
+    uint8_t *pixel = pixels.data() + ((size_t)span.start * 4);
+    for (uint32_t j = 0; j < span.length; ++j) {
+      pixel[0] = col.red;
+      pixel[1] = col.green;
+      pixel[2] = col.blue;
+      pixel[3] = 0xFF;
+      pixel += 4;
+    }
+  }
+}
+
+// one pass of the kernel over a number of rows, each tap is a fixed offset
+// from the byte being blurred so every byte of a row is done at once
+static void blur_pass(const uint8_t *src, uint8_t *dst, const std::vector<uint16_t> &kernel,
+  int32_t tapOffset, uint32_t firstRow, uint32_t lastRow)
+{
+  const int32_t half = (int32_t)kernel.size() / 2;
+  uint16_t sums[ROW_BYTES];
+  for (uint32_t y = firstRow; y < lastRow; ++y) {
+    const uint8_t *row = src + ((size_t)y * ROW_BYTES);
+    // start from a half so the result is rounded
+    for (int32_t i = 0; i < ROW_BYTES; ++i) {
+      sums[i] = 1 << (BLUR_WEIGHT_BITS - 1);
+    }
+    for (int32_t k = 0; k < (int32_t)kernel.size(); ++k) {
+      const uint8_t *tap = row + ((k - half) * tapOffset);
+      const uint16_t weight = kernel[k];
+      for (int32_t i = BLUR_MARGIN * 4; i < ROW_BYTES - (BLUR_MARGIN * 4); ++i) {
+        sums[i] += weight * tap[i];
+      }
+    }
+    uint8_t *out = dst + ((size_t)y * ROW_BYTES);
+    for (int32_t i = 0; i < ROW_BYTES; ++i) {
+      out[i] = (uint8_t)(sums[i] >> BLUR_WEIGHT_BITS);
+    }
+  }
+}
+
+// blur the pixels in place, only the rows around the rings are touched
+// because everything further out is transparent before and after
+static void blur(GalleryBuffers &buffers, const std::vector<uint16_t> &kernel)
+{
+  const uint32_t half = (uint32_t)kernel.size() / 2;
+  const uint32_t top = (CANVAS_SIZE / 2) - OUTER_RADIUS;
+  const uint32_t bottom = (CANVAS_SIZE / 2) + OUTER_RADIUS;
+  // along the rows then down the columns, the rows above and below the
+  // rings are never written in the row buffer so they're always clear
+  blur_pass(buffers.pixels.data(), buffers.rows.data(), kernel, 4, top, bottom);
+  blur_pass(buffers.rows.data(), buffers.pixels.data(), kernel, ROW_BYTES, top - half, bottom + half);
+}
+
+static bool write_png(const std::string &filename, const std::vector<uint8_t> &pixels)
+{
+  PNGWriter png;
+  if (!png.open(filename, CANVAS_SIZE, CANVAS_SIZE, true)) {
+    perror(("Failed to open " + filename).c_str());
+    return false;
+  }
+  png.write(pixels.data(), pixels.size());
+  if (!png.close()) {
+    perror(("Failed to write " + filename).c_str());
+    return false;
+  }
+  return true;
+}
+
+// the point on a circle around the center at a number of degrees
+// clockwise from the top
+static void append_point(std::string &svg, double radius, double angle)
+{
+  double rad = (angle - 90.0) * M_PI / 180.0;
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.3f %.3f", (CANVAS_SIZE / 2) + (radius * cos(rad)),
+      (CANVAS_SIZE / 2) + (radius * sin(rad)));
+  svg += buf;
+}
+
+// a segment of a ring between two angles, each edge is split into two arcs
+// so a full circle still has two distinct ends to draw between
+static void append_segment(std::string &svg, double inner, double outer,
+  uint32_t start, uint32_t end, RGBColor col)
+{
+  double mid = (start + end) / 2.0;
+  char buf[64];
+  svg += "<path d=\"M ";
+  append_point(svg, inner, start);
+  svg += " L ";
+  append_point(svg, outer, start);
+  snprintf(buf, sizeof(buf), " A %.0f %.0f 0 0 1 ", outer, outer);
+  svg += buf;
+  append_point(svg, outer, mid);
+  svg += buf;
+  append_point(svg, outer, end);
+  svg += " L ";
+  append_point(svg, inner, end);
+  snprintf(buf, sizeof(buf), " A %.0f %.0f 0 0 0 ", inner, inner);
+  svg += buf;
+  append_point(svg, inner, mid);
+  svg += buf;
+  append_point(svg, inner, start);
+  snprintf(buf, sizeof(buf), " Z\" fill=\"rgb(%u,%u,%u)\" />\n", col.red, col.green, col.blue);
+  svg += buf;
+}
+
+// the same rings as the png, each run of a color is one path
+static bool write_svg(const std::string &filename, const RenderCache::Frames &frames)
+{
+  char buf[256];
+  snprintf(buf, sizeof(buf), "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n"
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"%u\" height=\"%u\">\n",
+      CANVAS_SIZE, CANVAS_SIZE);
+  std::string svg = buf;
+  for (uint32_t ring = 0; ring < NUM_RINGS && !frames.empty(); ++ring) {
+    double outer = OUTER_RADIUS - (ring * (RING_THICKNESS + RING_GAP));
+    double inner = outer - RING_THICKNESS;
+    uint32_t start = 0;
+    for (uint32_t angle = 1; angle <= 360; ++angle) {
+      const RGBColor &col = frames[start % frames.size()];
+      if (angle < 360 && frames[angle % frames.size()] == col) {
+        continue;
+      }
+      if (!col.empty()) {
+        append_segment(svg, inner, outer, start, angle, col);
+      }
+      start = angle;
+    }
+  }
+  svg += "</svg>\n";
+  FILE *f = fopen(filename.c_str(), "wb");
+  if (!f) {
+    perror(("Failed to open " + filename).c_str());
+    return false;
+  }
+  bool success = (fwrite(svg.data(), 1, svg.length(), f) == svg.length());
+  if (fclose(f) != 0 || !success) {
+    perror(("Failed to write " + filename).c_str());
+    return false;
+  }
+  return true;
+}
+
+static void render_job(GalleryJob &job, RenderCache &cache, GalleryBuffers &buffers,
+  const std::vector<uint16_t> &kernel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // set the pattern up the same way the CLI would
+  Pattern pat = config_pattern(job.config);
+  std::shared_ptr<const RenderCache::Frames> frames = cache.render(pat, job.brightness_scale, GALLERY_CYCLES);
+  draw_rings(buffers.pixels, *frames);
+  blur(buffers, kernel);
+  job.success = write_png(GALLERY_PNG_DIR "/" + job.name + ".png", buffers.pixels) &&
+    write_svg(GALLERY_SVG_DIR "/" + job.name + ".svg", *frames);
+  job.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int run_gallery(const std::string &patternDir, uint32_t numThreads, const std::string &renderCacheDir)
+{
+  std::vector<std::string> names;
+  if (!list_pattern_files(patternDir, names)) {
+    return 1;
+  }
+  std::vector<GalleryJob> jobs(names.size() + PATTERN_COUNT);
+  for (size_t i = 0; i < names.size(); ++i) {
+    jobs[i].name = names[i];
+    if (!parse_pattern_file(patternDir + "/" + names[i] + PATTERN_FILE_EXT, jobs[i])) {
+      return 1;
+    }
+  }
+  // the built in patterns are numbered on from the pattern files
+  for (uint32_t i = 0; i < PATTERN_COUNT; ++i) {
+    GalleryJob &job = jobs[names.size() + i];
+    char name[32];
+    snprintf(name, sizeof(name), "%03u_Pattern", (uint32_t)(names.size() + i + 1));
+    job.name = name;
+    job.config.pattern = std::to_string(i);
+    job.config.colorset = GENERIC_COLORSET;
+    job.brightness_scale = GENERIC_BRIGHTNESS_SCALE;
+  }
+  if (!make_dir(GALLERY_PNG_DIR) || !make_dir(GALLERY_SVG_DIR) ||
+      (renderCacheDir.length() > 0 && !make_dir(renderCacheDir))) {
+    return 1;
+  }
+  RenderCache cache((uint32_t)jobs.size(), renderCacheDir);
+  const std::vector<uint16_t> kernel = make_blur_kernel();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint32_t workers = 0;
+  // each worker sets up it's own buffers the first time it runs a job
+  std::vector<std::unique_ptr<GalleryBuffers> > buffers;
+  {
+    WorkPool pool(numThreads);
+    workers = pool.numWorkers();
+    buffers.resize(workers);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      GalleryJob *job = &jobs[i];
+      pool.submit([job, &cache, &buffers, &kernel](uint32_t worker) {
+        if (!buffers[worker]) {
+          buffers[worker].reset(new GalleryBuffers());
+        }
+        render_job(*job, cache, *buffers[worker], kernel);
+      });
+    }
+    pool.wait();
+  }
+  double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  uint32_t failures = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (!jobs[i].success) {
+      printf("%s: FAILED\n", jobs[i].name.c_str());
+      failures++;
+    }
+  }
+  printf("Gallery: %zu patterns on %u threads in %.3fms (%llu rendered, %llu loaded)\n",
+      jobs.size(), workers, elapsed_ms, (unsigned long long)cache.misses(),
+      (unsigned long long)cache.diskHits());
+  return failures ? 1 : 0;
+}
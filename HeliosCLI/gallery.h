@@ -0,0 +1,26 @@
+#ifndef GALLERY_H
+#define GALLERY_H
+
+#include <inttypes.h>
+#include <string>
+
+// Render the pattern gallery, every .pattern file in a directory plus each of
+// the built in patterns with a plain red, green and blue colorset. Each one
+// is drawn as three rings of it's first few hundred frames and saved as a PNG
+// in circular_patterns_png and an SVG in circular_patterns_svg, named after
+// the pattern file (or NNN_Pattern for the built in ones).
+//
+// A pattern file holds key=value lines the same as generate_bmps.sh reads:
+//
+//   COLOR_SET=red,orange,yellow
+//   PATTERN_ID=3          or  PATTERN_ARGS=2,,40
+//   BRIGHTNESS_SCALE=2.0
+//
+// The patterns render in parallel on a pool of numThreads workers (0 is one
+// per core) and the images are encoded straight from memory. With a render
+// cache dir the frames of unchanged patterns are loaded instead of simulated.
+//
+// Returns the process exit code, non-zero if any pattern failed
+int run_gallery(const std::string &patternDir, uint32_t numThreads, const std::string &renderCacheDir);
+
+#endif
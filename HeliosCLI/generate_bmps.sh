@@ -3,6 +3,8 @@
 HELIOS=./helios
 PATTERN_DIR=./default_patterns
 BMP_DIR=./bmp_patterns
+# renders of patterns that haven't changed are loaded from here
+RENDER_CACHE_DIR=./render_cache
 
 # Default values
 CYCLE_COUNT=2
@@ -66,7 +68,8 @@ for pattern_file in "$PATTERN_DIR"/*.pattern; do
             --colorset "$COLOR_SET" \
             $PATTERN_ARG_STR \
             --bmp "$BMP_DIR/${filename}.bmp" \
-            --cycle "$CYCLE_COUNT"
+            --cycle "$CYCLE_COUNT" \
+            --render-cache "$RENDER_CACHE_DIR"
     else
         $HELIOS \
             --quiet \
@@ -95,7 +98,8 @@ if [ "$INCLUDE_GENERIC_FLASHING_PATTERNS" -eq 1 ]; then
               --colorset "red,green,blue" \
               --pattern "$i" \
               --bmp "$BMP_DIR/$(printf "%03d_Pattern.bmp" $((i + NUM_DEFAULT_PATTERNS + 1)))" \
-              --cycle "$CYCLE_COUNT"
+              --cycle "$CYCLE_COUNT" \
+              --render-cache "$RENDER_CACHE_DIR"
       else
           $HELIOS \
               --quiet \
@@ -0,0 +1,321 @@
+#include <string.h>
+
+#include "image_writer.h"
+
+// the number of pixel bytes held before they go out to the file
+#define IMAGE_BUFFER_SIZE (64 * 1024)
+// the size of the compressed data in each PNG IDAT chunk
+#define PNG_CHUNK_SIZE (64 * 1024)
+
+// need structure alignment for BMP header structures
+#pragma pack(push, 1)
+struct BMPHeader {
+  char signature[2];
+  uint32_t fileSize;
+  uint32_t reserved;
+  uint32_t dataOffset;
+};
+struct DIBHeader {
+  uint32_t headerSize;
+  int32_t width;
+  int32_t height;
+  uint16_t planes;
+  uint16_t bitsPerPixel;
+  uint32_t compression;
+  uint32_t imageSize;
+  int32_t xPixelsPerMeter;
+  int32_t yPixelsPerMeter;
+  uint32_t colorsInColorTable;
+  uint32_t importantColorCount;
+};
+#pragma pack(pop)
+
+BMPWriter::BMPWriter() :
+  m_file(nullptr),
+  m_buffer(IMAGE_BUFFER_SIZE),
+  m_len(0),
+  m_numPixels(0)
+{
+}
+
+BMPWriter::~BMPWriter()
+{
+  if (m_file) {
+    fclose(m_file);
+  }
+}
+
+bool BMPWriter::open(const std::string &filename)
+{
+  m_file = fopen(filename.c_str(), "wb");
+  if (!m_file) {
+    return false;
+  }
+  m_len = 0;
+  m_numPixels = 0;
+  writeHeader();
+  return !ferror(m_file);
+}
+
+void BMPWriter::write(RGBColor col, uint32_t count)
+{
+  if (!m_file) {
+    return;
+  }
+  m_numPixels += count;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (m_len + 3 > m_buffer.size()) {
+      flush();
+    }
+    // BGR format
+    m_buffer[m_len++] = col.blue;
+    m_buffer[m_len++] = col.green;
+    m_buffer[m_len++] = col.red;
+  }
+}
+
+bool BMPWriter::close()
+{
+  if (!m_file) {
+    return false;
+  }
+  // rows are padded to the nearest multiple of 4 bytes
+  uint32_t padding = (uint32_t)((4 - ((m_numPixels * 3) % 4)) % 4);
+  flush();
+  fwrite("\0\0\0", 1, padding, m_file);
+  writeHeader();
+  bool success = !ferror(m_file) && m_numPixels <= INT32_MAX;
+  if (fclose(m_file) != 0) {
+    success = false;
+  }
+  m_file = nullptr;
+  return success;
+}
+
+void BMPWriter::flush()
+{
+  fwrite(m_buffer.data(), 1, m_len, m_file);
+  m_len = 0;
+  // keep the file a valid image of everything written so far
+  writeHeader();
+}
+
+void BMPWriter::writeHeader()
+{
+  const int32_t width = (m_numPixels > INT32_MAX) ? INT32_MAX : (int32_t)m_numPixels;
+  const uint32_t rowPaddedSize = ((uint32_t)width * 3 + 3) & ~3;
+  const uint32_t imageSize = rowPaddedSize;
+  // BMP header (14 bytes) + DIB header (40 bytes) + image data
+  BMPHeader bmpHeader = {{'B', 'M'}, 54 + imageSize, 0, 54};
+  DIBHeader dibHeader = {40, width, 1, 1, 24, 0, imageSize, 2835, 2835, 0, 0};
+  long pos = ftell(m_file);
+  fseek(m_file, 0, SEEK_SET);
+  fwrite(&bmpHeader, 1, sizeof(bmpHeader), m_file);
+  fwrite(&dibHeader, 1, sizeof(dibHeader), m_file);
+  if (pos > 0) {
+    fseek(m_file, pos, SEEK_SET);
+  }
+}
+
+// the table of the CRC of PNG chunks
+struct CRCTable
+{
+  CRCTable()
+  {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (uint32_t k = 0; k < 8; ++k) {
+        c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      }
+      entries[n] = c;
+    }
+  }
+  uint32_t entries[256];
+};
+
+static uint32_t png_crc(const uint8_t *data, size_t len, uint32_t crc = 0xFFFFFFFF)
+{
+  // built the first time it's needed, this is safe across threads
+  static const CRCTable table;
+  for (size_t i = 0; i < len; ++i) {
+    crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+static void put_uint32_be(uint8_t *out, uint32_t val)
+{
+  out[0] = (uint8_t)(val >> 24);
+  out[1] = (uint8_t)(val >> 16);
+  out[2] = (uint8_t)(val >> 8);
+  out[3] = (uint8_t)val;
+}
+
+PNGWriter::PNGWriter() :
+  m_file(nullptr),
+  m_width(0),
+  m_height(0),
+  m_pixelSize(3),
+  m_strip(false),
+  m_numBytes(0),
+  m_rowBytes(0),
+  m_headerPos(0),
+  m_deflater(),
+  m_compressed(),
+  m_buffer(IMAGE_BUFFER_SIZE),
+  m_len(0)
+{
+}
+
+PNGWriter::~PNGWriter()
+{
+  if (m_file) {
+    fclose(m_file);
+  }
+}
+
+bool PNGWriter::open(const std::string &filename, uint32_t width, uint32_t height, bool alpha)
+{
+  m_file = fopen(filename.c_str(), "wb");
+  if (!m_file) {
+    return false;
+  }
+  m_strip = (width == 0);
+  m_width = width;
+  m_height = m_strip ? 1 : height;
+  m_pixelSize = alpha ? 4 : 3;
+  m_rowBytes = (uint64_t)m_width * m_pixelSize;
+  m_numBytes = 0;
+  m_len = 0;
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  fwrite(signature, 1, sizeof(signature), m_file);
+  m_headerPos = ftell(m_file);
+  writeHeader();
+  return !ferror(m_file);
+}
+
+void PNGWriter::write(const uint8_t *pixels, size_t len)
+{
+  if (!m_file) {
+    return;
+  }
+  while (len > 0) {
+    // every row starts with it's filter type, the pixels are never filtered
+    // because runs of the same color already compress down to nothing
+    if (m_strip ? !m_numBytes : !(m_numBytes % m_rowBytes)) {
+      if (m_len == m_buffer.size()) {
+        compress(m_buffer.data(), m_len);
+        m_len = 0;
+      }
+      m_buffer[m_len++] = 0;
+    }
+    size_t chunk = m_buffer.size() - m_len;
+    if (!m_strip && chunk > m_rowBytes - (m_numBytes % m_rowBytes)) {
+      chunk = (size_t)(m_rowBytes - (m_numBytes % m_rowBytes));
+    }
+    if (chunk > len) {
+      chunk = len;
+    }
+    memcpy(m_buffer.data() + m_len, pixels, chunk);
+    m_len += chunk;
+    m_numBytes += chunk;
+    pixels += chunk;
+    len -= chunk;
+    if (m_len == m_buffer.size()) {
+      compress(m_buffer.data(), m_len);
+      m_len = 0;
+    }
+  }
+}
+
+void PNGWriter::write(RGBColor col, uint32_t count)
+{
+  // fill a block with the color once and write it as many times as needed
+  uint8_t block[3 * 256];
+  uint32_t blockPixels = count < 256 ? count : 256;
+  for (uint32_t i = 0; i < blockPixels; ++i) {
+    block[(i * 3) + 0] = col.red;
+    block[(i * 3) + 1] = col.green;
+    block[(i * 3) + 2] = col.blue;
+  }
+  while (count > 0) {
+    uint32_t n = count < blockPixels ? count : blockPixels;
+    write(block, n * 3);
+    count -= n;
+  }
+}
+
+bool PNGWriter::close()
+{
+  if (!m_file) {
+    return false;
+  }
+  bool success = true;
+  if (m_strip) {
+    m_width = (uint32_t)(m_numBytes / m_pixelSize);
+    success = (m_numBytes / m_pixelSize) <= INT32_MAX;
+  } else {
+    success = (m_numBytes == m_rowBytes * m_height);
+  }
+  compress(m_buffer.data(), m_len);
+  m_len = 0;
+  m_deflater.finish(m_compressed);
+  if (m_compressed.size() > 0) {
+    writeChunk("IDAT", (const uint8_t *)m_compressed.data(), (uint32_t)m_compressed.size());
+    m_compressed.clear();
+  }
+  writeChunk("IEND", nullptr, 0);
+  if (m_strip) {
+    // now the width is known
+    fseek(m_file, m_headerPos, SEEK_SET);
+    writeHeader();
+  }
+  if (ferror(m_file)) {
+    success = false;
+  }
+  if (fclose(m_file) != 0) {
+    success = false;
+  }
+  m_file = nullptr;
+  return success;
+}
+
+void PNGWriter::compress(const uint8_t *data, size_t len)
+{
+  m_deflater.write(data, len, m_compressed);
+  if (m_compressed.size() >= PNG_CHUNK_SIZE) {
+    writeChunk("IDAT", (const uint8_t *)m_compressed.data(), (uint32_t)m_compressed.size());
+    m_compressed.clear();
+  }
+}
+
+void PNGWriter::writeChunk(const char *type, const uint8_t *data, uint32_t len)
+{
+  uint8_t header[8];
+  put_uint32_be(header, len);
+  memcpy(header + 4, type, 4);
+  uint32_t crc = png_crc(header + 4, 4);
+  crc = png_crc(data, len, crc) ^ 0xFFFFFFFF;
+  uint8_t trailer[4];
+  put_uint32_be(trailer, crc);
+  fwrite(header, 1, sizeof(header), m_file);
+  if (len > 0) {
+    fwrite(data, 1, len, m_file);
+  }
+  fwrite(trailer, 1, sizeof(trailer), m_file);
+}
+
+void PNGWriter::writeHeader()
+{
+  uint8_t ihdr[13];
+  put_uint32_be(ihdr, m_width);
+  put_uint32_be(ihdr + 4, m_height);
+  // 8 bits per channel, truecolor with or without alpha, deflate, no
+  // filtering scheme beyond the default and no interlacing
+  ihdr[8] = 8;
+  ihdr[9] = (m_pixelSize == 4) ? 6 : 2;
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+  writeChunk("IHDR", ihdr, sizeof(ihdr));
+}
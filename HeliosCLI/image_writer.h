@@ -0,0 +1,88 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Colortypes.h"
+#include "deflate.h"
+
+// Streaming image writers, the pixels go straight out to the file through a
+// fixed size buffer so an image of any size is written in constant memory.
+//
+// Both can write a strip: an image one pixel tall whose width grows as the
+// pixels come in, one pixel per tick of led output. The width is filled in
+// when the image is closed.
+
+// a 24 bit BMP, the header is rewritten every time the buffer goes out so
+// the file is always a valid image of everything written so far
+class BMPWriter
+{
+public:
+  BMPWriter();
+  ~BMPWriter();
+
+  // start a strip
+  bool open(const std::string &filename);
+  // add a number of pixels of the same color
+  void write(RGBColor col, uint32_t count);
+  // pad the row and fill in the final size, returns false if anything failed
+  bool close();
+
+  uint64_t numPixels() const { return m_numPixels; }
+
+private:
+  void flush();
+  void writeHeader();
+
+  FILE *m_file;
+  std::vector<uint8_t> m_buffer;
+  size_t m_len;
+  uint64_t m_numPixels;
+};
+
+// an 8 bit RGB or RGBA PNG compressed with the built in deflate
+class PNGWriter
+{
+public:
+  PNGWriter();
+  ~PNGWriter();
+
+  // start an image of the given size, or a strip if the width is 0
+  bool open(const std::string &filename, uint32_t width, uint32_t height, bool alpha);
+  // add pixels in row order, three or four bytes each
+  void write(const uint8_t *pixels, size_t len);
+  // add a number of pixels of the same color to an RGB image
+  void write(RGBColor col, uint32_t count);
+  // end the image and fill in the size of a strip, returns false if
+  // anything failed or the image isn't the size it was opened with
+  bool close();
+
+  uint64_t numPixels() const { return m_numBytes / m_pixelSize; }
+
+private:
+  void compress(const uint8_t *data, size_t len);
+  void writeChunk(const char *type, const uint8_t *data, uint32_t len);
+  void writeHeader();
+
+  FILE *m_file;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_pixelSize;
+  bool m_strip;
+  // the pixel bytes written so far and the bytes in each row
+  uint64_t m_numBytes;
+  uint64_t m_rowBytes;
+  // where the header is so a strip can fill in it's width
+  long m_headerPos;
+  Deflater m_deflater;
+  // compressed data waiting to go out in an IDAT chunk
+  std::string m_compressed;
+  // pixels waiting to be compressed
+  std::vector<uint8_t> m_buffer;
+  size_t m_len;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "HeliosEngine.h"
+#include "Button.h"
+
+#include "input_script.h"
+
+const char *queue_input_runs(const char *inputs, const char *end)
+{
+  const char *queued = inputs;
+  char command = 0;
+  uint32_t count = 0;
+  while (HeliosEngine::nextInputRun(inputs, end, command, count)) {
+    Button::queueInput(command, count);
+    queued = inputs;
+  }
+  return queued;
+}
+
+bool queue_input_file(const std::string &filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror(("Failed to open input file " + filename).c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(("Failed to read input file " + filename).c_str());
+    close(fd);
+    return false;
+  }
+  // pipes and other streams can't be mapped so read them in whole instead
+  if (!S_ISREG(st.st_mode)) {
+    std::string script;
+    char buf[4096];
+    ssize_t len = 0;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+      script.append(buf, len);
+    }
+    close(fd);
+    if (len < 0) {
+      perror(("Failed to read input file " + filename).c_str());
+      return false;
+    }
+    queue_input_runs(script.data(), script.data() + script.length());
+    return true;
+  }
+  // there is nothing to map in an empty file
+  if (!st.st_size) {
+    close(fd);
+    return true;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping holds it's own reference to the file
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(("Failed to map input file " + filename).c_str());
+    return false;
+  }
+  // the script is read front to back exactly once
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  const char *begin = (const char *)data;
+  queue_input_runs(begin, begin + st.st_size);
+  munmap(data, st.st_size);
+  return true;
+}
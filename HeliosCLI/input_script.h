@@ -0,0 +1,21 @@
+#ifndef INPUT_SCRIPT_H
+#define INPUT_SCRIPT_H
+
+#include <string>
+
+// Input scripts are the same commands the CLI reads from stdin, ex:
+// 300wcp1500wr300wq, with any whitespace ignored. They are compiled into
+// runs of repeated commands in the button queue of the device currently in
+// the engine globals, so the button pulls each input straight out of memory
+// and a wait of any length is a single entry.
+
+// compile the commands between inputs and end into the button queue, returns
+// where the commands stopped which is either the end or the start of a repeat
+// count that still needs the command that follows it
+const char *queue_input_runs(const char *inputs, const char *end);
+
+// map a script file into memory and compile all of it into the button queue
+// in one pass, returns false if the file can't be read
+bool queue_input_file(const std::string &filename);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef LED_DIGEST_H
+#define LED_DIGEST_H
+
+#include <inttypes.h>
+
+#include "Colortypes.h"
+
+// FNV-1a over the r/g/b bytes of every frame the device showed, the farm and
+// --digest hash the same way so their digests can be compared
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static inline uint64_t digest_color(uint64_t hash, RGBColor col)
+{
+  hash = (hash ^ col.red) * FNV_PRIME;
+  hash = (hash ^ col.green) * FNV_PRIME;
+  hash = (hash ^ col.blue) * FNV_PRIME;
+  return hash;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "output_writer.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// every pair of decimal digits so numbers are written two digits at a time
+static const char decimal_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+OutputWriter::OutputWriter(int fd, size_t size) :
+  m_fd(fd),
+  m_buffer(new char[size]),
+  m_size(size),
+  m_len(0)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+  flush();
+  delete[] m_buffer;
+}
+
+void OutputWriter::write(const char *data, size_t len)
+{
+  if (len > m_size) {
+    // too big to be worth buffering
+    flush();
+    writeAll(data, len);
+    return;
+  }
+  reserve(len);
+  memcpy(m_buffer + m_len, data, len);
+  m_len += len;
+}
+
+void OutputWriter::put(char c)
+{
+  reserve(1);
+  m_buffer[m_len++] = c;
+}
+
+void OutputWriter::putHex(RGBColor col)
+{
+  reserve(6);
+  char *out = m_buffer + m_len;
+  out[0] = hex_digits[col.red >> 4];
+  out[1] = hex_digits[col.red & 0xF];
+  out[2] = hex_digits[col.green >> 4];
+  out[3] = hex_digits[col.green & 0xF];
+  out[4] = hex_digits[col.blue >> 4];
+  out[5] = hex_digits[col.blue & 0xF];
+  m_len += 6;
+}
+
+void OutputWriter::putDecimal(uint32_t val)
+{
+  // fill a scratch buffer from the end, a uint32 is at most 10 digits
+  char digits[10];
+  char *pos = digits + sizeof(digits);
+  while (val >= 100) {
+    uint32_t pair = (val % 100) * 2;
+    val /= 100;
+    *--pos = decimal_pairs[pair + 1];
+    *--pos = decimal_pairs[pair];
+  }
+  if (val >= 10) {
+    *--pos = decimal_pairs[(val * 2) + 1];
+    *--pos = decimal_pairs[val * 2];
+  } else {
+    *--pos = (char)('0' + val);
+  }
+  write(pos, (digits + sizeof(digits)) - pos);
+}
+
+void OutputWriter::putRGB(RGBColor col)
+{
+  reserve(3);
+  char *out = m_buffer + m_len;
+  out[0] = (char)col.red;
+  out[1] = (char)col.green;
+  out[2] = (char)col.blue;
+  m_len += 3;
+}
+
+void OutputWriter::putUint32(uint32_t val)
+{
+  reserve(4);
+  char *out = m_buffer + m_len;
+  out[0] = (char)(val & 0xFF);
+  out[1] = (char)((val >> 8) & 0xFF);
+  out[2] = (char)((val >> 16) & 0xFF);
+  out[3] = (char)(val >> 24);
+  m_len += 4;
+}
+
+bool OutputWriter::flush()
+{
+  size_t len = m_len;
+  m_len = 0;
+  return writeAll(m_buffer, len);
+}
+
+bool OutputWriter::writeAll(const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t written = ::write(m_fd, data, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // most likely the reader went away, nothing more can be written
+      return false;
+    }
+    data += written;
+    len -= written;
+  }
+  return true;
+}
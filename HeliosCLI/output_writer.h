@@ -0,0 +1,62 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Colortypes.h"
+
+// Buffers the output of the CLI and writes it to a file descriptor in large
+// blocks. The buffer is allocated once up front and frames are formatted into
+// it with digit tables, so printing a frame never allocates or makes a
+// syscall until the buffer fills up or is flushed.
+//
+// Nothing else should write to the same descriptor while anything is still
+// sitting in the buffer, flush first.
+class OutputWriter
+{
+public:
+  OutputWriter(int fd, size_t size);
+  ~OutputWriter();
+
+  void write(const char *data, size_t len);
+  void write(const char *str) { write(str, strlen(str)); }
+  void put(char c);
+  // two uppercase hex digits for each channel, ex: FF3C00
+  void putHex(RGBColor col);
+  // a number in decimal without any padding
+  void putDecimal(uint32_t val);
+  // the raw red, green and blue bytes
+  void putRGB(RGBColor col);
+  // four bytes, least significant first
+  void putUint32(uint32_t val);
+
+  // switch to another descriptor, anything buffered goes to the old one
+  void setFd(int fd)
+  {
+    flush();
+    m_fd = fd;
+  }
+
+  // write out everything in the buffer
+  bool flush();
+
+private:
+  // write straight to the descriptor until everything is written
+  bool writeAll(const char *data, size_t len);
+  // make room for at least len more bytes
+  void reserve(size_t len)
+  {
+    if (m_len + len > m_size) {
+      flush();
+    }
+  }
+
+  int m_fd;
+  char *m_buffer;
+  size_t m_size;
+  size_t m_len;
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <map>
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "Pattern.h"
+
+#include "device_config.h"
+#include "image_writer.h"
+#include "render_cache.h"
+#include "work_pool.h"
+#include "render_batch.h"
+
+// the most jobs that are read ahead of the workers, reading the manifest
+// waits for the workers to catch up so memory stays the same however many
+// jobs there are
+#define BATCH_MAX_PENDING 256
+// the number of renders shared between jobs that render the same thing
+#define BATCH_CACHE_ENTRIES 64
+
+// a single render in the batch and the results of it
+struct BatchJob
+{
+  BatchJob() :
+    index(0), name(), config(), brightness_scale(1.0f), num_cycles(1), output(),
+    frames(0), wall_ms(0), success(false) {}
+
+  // the position of the job in the manifest
+  uint32_t index;
+
+  // the job description
+  std::string name;
+  DeviceConfig config;
+  float brightness_scale;
+  uint32_t num_cycles;
+  std::string output;
+
+  // the results
+  uint64_t frames;
+  double wall_ms;
+  bool success;
+};
+
+// the summary of the finished jobs, they finish in any order but are
+// reported in the order of the manifest
+struct BatchReport
+{
+  BatchReport() :
+    mutex(), finished(), next(0), failures(0), frames(0) {}
+
+  std::mutex mutex;
+  // jobs that finished before an earlier job did
+  std::map<uint32_t, std::shared_ptr<BatchJob> > finished;
+  // the index of the next job to report
+  uint32_t next;
+  uint32_t failures;
+  uint64_t frames;
+};
+
+static bool has_extension(const std::string &filename, const std::string &ext)
+{
+  return filename.length() > ext.length() &&
+    filename.compare(filename.length() - ext.length(), ext.length(), ext) == 0;
+}
+
+// parse one line of the manifest, returns false if the line is malformed
+static bool parse_job(const std::string &line, uint32_t lineNum, BatchJob &job)
+{
+  std::istringstream ss(line);
+  std::string field;
+  job.name = std::to_string(lineNum);
+  while (ss >> field) {
+    size_t eq = field.find('=');
+    if (eq == std::string::npos) {
+      fprintf(stderr, "Manifest line %u: expected key=value but got '%s'\n", lineNum, field.c_str());
+      return false;
+    }
+    std::string key = field.substr(0, eq);
+    std::string val = field.substr(eq + 1);
+    if (key == "name") {
+      job.name = val;
+    } else if (key == "colorset") {
+      job.config.colorset = val;
+    } else if (key == "pattern") {
+      job.config.pattern = val;
+    } else if (key == "pattern-args") {
+      job.config.pattern_args = val;
+    } else if (key == "brightness") {
+      job.brightness_scale = strtof(val.c_str(), NULL);
+      if (!job.brightness_scale) {
+        job.brightness_scale = 1.0f;
+      }
+    } else if (key == "cycles") {
+      job.num_cycles = strtoul(val.c_str(), NULL, 10);
+      if (!job.num_cycles) {
+        job.num_cycles = 1;
+      }
+    } else if (key == "output") {
+      job.output = val;
+    } else {
+      fprintf(stderr, "Manifest line %u: unknown field '%s'\n", lineNum, key.c_str());
+      return false;
+    }
+  }
+  if (job.output.length() > 0 && !has_extension(job.output, ".bmp") && !has_extension(job.output, ".png")) {
+    fprintf(stderr, "Manifest line %u: output must be a .bmp or .png file\n", lineNum);
+    return false;
+  }
+  return true;
+}
+
+// write the render to a strip, each run of a color goes in at once
+template <typename Writer>
+static bool write_strip(Writer &writer, const RenderCache::Frames &frames)
+{
+  size_t i = 0;
+  while (i < frames.size()) {
+    size_t run = 1;
+    while (i + run < frames.size() && frames[i + run] == frames[i]) {
+      run++;
+    }
+    writer.write(frames[i], (uint32_t)run);
+    i += run;
+  }
+  return writer.close();
+}
+
+static bool write_output(const std::string &filename, const RenderCache::Frames &frames)
+{
+  bool success = false;
+  if (has_extension(filename, ".bmp")) {
+    BMPWriter bmp;
+    success = bmp.open(filename) && write_strip(bmp, frames);
+  } else {
+    PNGWriter png;
+    success = png.open(filename, 0, 1, false) && write_strip(png, frames);
+  }
+  if (!success) {
+    perror(("Failed to write " + filename).c_str());
+  }
+  return success;
+}
+
+static void render_job(BatchJob &job, RenderCache &cache)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Pattern pat = config_pattern(job.config);
+  std::shared_ptr<const RenderCache::Frames> frames = cache.render(pat, job.brightness_scale, job.num_cycles);
+  job.frames = frames->size();
+  job.success = job.output.empty() || write_output(job.output, *frames);
+  job.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// report a finished job and any later ones that were waiting on it
+static void finish_job(BatchReport &report, std::shared_ptr<BatchJob> job)
+{
+  std::lock_guard<std::mutex> lock(report.mutex);
+  report.finished[job->index] = job;
+  std::map<uint32_t, std::shared_ptr<BatchJob> >::iterator it = report.finished.begin();
+  while (it != report.finished.end() && it->first == report.next) {
+    const BatchJob &done = *it->second;
+    if (done.success) {
+      printf("%s: frames=%llu wall=%.3fms\n", done.name.c_str(), (unsigned long long)done.frames, done.wall_ms);
+      report.frames += done.frames;
+    } else {
+      printf("%s: FAILED\n", done.name.c_str());
+      report.failures++;
+    }
+    report.next++;
+    it = report.finished.erase(it);
+  }
+}
+
+int run_render_batch(const std::string &manifest, uint32_t numThreads, const std::string &renderCacheDir)
+{
+  std::ifstream file;
+  if (manifest != "-") {
+    file.open(manifest);
+    if (!file.is_open()) {
+      fprintf(stderr, "Failed to open manifest: %s\n", manifest.c_str());
+      return 1;
+    }
+  }
+  std::istream &in = (manifest == "-") ? std::cin : file;
+  // it's fine if the directory already exists
+  if (renderCacheDir.length() > 0 && mkdir(renderCacheDir.c_str(), 0755) != 0 && errno != EEXIST) {
+    perror("Failed to create render cache directory");
+    return 1;
+  }
+  RenderCache cache(BATCH_CACHE_ENTRIES, renderCacheDir);
+  BatchReport report;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint32_t numJobs = 0;
+  uint32_t workers = 0;
+  {
+    WorkPool pool(numThreads, BATCH_MAX_PENDING);
+    workers = pool.numWorkers();
+    std::string line;
+    uint32_t lineNum = 0;
+    while (std::getline(in, line)) {
+      lineNum++;
+      // strip windows line endings and skip blank lines or comments
+      if (line.length() && line[line.length() - 1] == '\r') {
+        line.erase(line.length() - 1);
+      }
+      size_t lineStart = line.find_first_not_of(" \t");
+      if (lineStart == std::string::npos || line[lineStart] == '#') {
+        continue;
+      }
+      std::shared_ptr<BatchJob> job(new BatchJob());
+      job->index = numJobs++;
+      // a bad line fails that job and the rest carry on
+      if (!parse_job(line, lineNum, *job)) {
+        finish_job(report, job);
+        continue;
+      }
+      pool.submit([job, &cache, &report](uint32_t worker) {
+        render_job(*job, cache);
+        finish_job(report, job);
+      });
+    }
+    pool.wait();
+  }
+  double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("Batch: %u jobs on %u threads, %llu frames in %.3fms (%.0f jobs/sec), %llu rendered, %llu loaded, %llu shared\n",
+      numJobs, workers, (unsigned long long)report.frames, elapsed_ms,
+      elapsed_ms > 0 ? (numJobs * 1000.0) / elapsed_ms : 0, (unsigned long long)cache.misses(),
+      (unsigned long long)cache.diskHits(), (unsigned long long)cache.hits());
+  return report.failures ? 1 : 0;
+}
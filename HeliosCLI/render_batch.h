@@ -0,0 +1,34 @@
+#ifndef RENDER_BATCH_H
+#define RENDER_BATCH_H
+
+#include <inttypes.h>
+#include <string>
+
+// Render a manifest of pattern jobs in one process, the same renders that
+// --cycle makes for one pattern at a time. The manifest is streamed a line at
+// a time into a bounded pool of workers so it can hold any number of jobs
+// without holding them all in memory, or be - to read it from stdin. There is
+// one job per line made of key=value fields, blank lines and lines starting
+// with # are ignored:
+//
+//   name=lightside colorset=red,orange,yellow pattern-args=2,,40 brightness=2.0 output=lightside.png
+//   name=strobe colorset=red,green,blue pattern=1 cycles=2 output=strobe.bmp
+//
+// Fields:
+//   name=<str>          name of the job in the summary (default: line number)
+//   colorset=<list>     same as --colorset
+//   pattern=<id>        same as --pattern
+//   pattern-args=<list> same as --pattern-args
+//   brightness=<f>      same as --brightness-scale
+//   cycles=<n>          same as --cycle (default: 1)
+//   output=<file>       write the render to a .bmp or .png strip
+//
+// A summary line with the timing of each job is printed in manifest order as
+// the jobs finish, followed by the totals. Jobs that render the same thing
+// share a render through a small cache, with a render cache dir they are also
+// loaded from and saved to it.
+//
+// Returns the process exit code, non-zero if any job failed
+int run_render_batch(const std::string &manifest, uint32_t numThreads, const std::string &renderCacheDir);
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "HeliosEngine.h"
+#include "Helios.h"
+#include "TimeControl.h"
+#include "Pattern.h"
+#include "Led.h"
+
+#include "render_cache.h"
+
+// the first bytes of every render file
+#define RENDER_FILE_MAGIC "HRC2"
+
+// FNV-1a of the key for the file name
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// the stored bytes of the pattern then the render parameters
+static std::string make_key(const Pattern &pat, float brightnessScale, uint32_t numCycles)
+{
+  std::string key((const char *)&pat, PATTERN_SIZE);
+  key.append((const char *)&brightnessScale, sizeof(brightnessScale));
+  key.append((const char *)&numCycles, sizeof(numCycles));
+  return key;
+}
+
+RenderCache::RenderCache(uint32_t maxEntries, const std::string &dir) :
+  m_maxEntries(maxEntries ? maxEntries : 1),
+  m_dir(dir),
+  m_entries(),
+  m_index(),
+  m_mutex(),
+  m_hits(0),
+  m_diskHits(0),
+  m_misses(0)
+{
+}
+
+std::shared_ptr<const RenderCache::Frames> RenderCache::render(const Pattern &pat,
+  float brightnessScale, uint32_t numCycles)
+{
+  std::string key = make_key(pat, brightnessScale, numCycles);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+    if (it != m_index.end()) {
+      // move it to the front of the list
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      m_hits++;
+      return it->second->second;
+    }
+  }
+  // the lock isn't held while loading or simulating so other threads can
+  // keep going, two threads might render the same thing but that's harmless
+  std::shared_ptr<const Frames> frames = load(key);
+  bool loaded = (frames != nullptr);
+  if (!loaded) {
+    frames = simulate(pat, brightnessScale, numCycles);
+    save(key, *frames);
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (loaded) {
+    m_diskHits++;
+  } else {
+    m_misses++;
+  }
+  insert(key, frames);
+  return frames;
+}
+
+std::shared_ptr<const RenderCache::Frames> RenderCache::simulate(const Pattern &pat,
+  float brightnessScale, uint32_t numCycles)
+{
+  std::shared_ptr<Frames> frames(new Frames());
+  // the pattern might be the current pattern of this thread which the engine
+  // is about to swap out, so take a copy first
+  Pattern copy(pat);
+  // play the pattern as the only mode of a fresh device so it runs exactly
+  // the way the CLI would show it, the engine keeps it off this thread
+  HeliosEngine engine;
+  engine.enableStorage(false);
+  engine.bind();
+  Helios::init();
+  Pattern &cur = Helios::cur_pattern();
+  cur = copy;
+  cur.init();
+  cur.seek(cur.periodStart());
+  uint64_t numTicks = (uint64_t)numCycles * cur.period();
+  frames->reserve(numTicks);
+  while (frames->size() < numTicks) {
+    Helios::tick();
+    // nothing is queued so every tick until the next event looks the same
+    uint32_t now = Time::getCurtime();
+    uint32_t next = Helios::next_event_tick();
+    uint64_t left = numTicks - frames->size();
+    if (next == UINT32_MAX || next - now >= left) {
+      next = now + (uint32_t)left - 1;
+    }
+    Helios::skip_to(next);
+    frames->insert(frames->end(), 1 + (next - now), Led::get().scaleBrightness(brightnessScale));
+  }
+  engine.unbind();
+  return frames;
+}
+
+std::shared_ptr<const RenderCache::Frames> RenderCache::load(const std::string &key)
+{
+  if (m_dir.empty()) {
+    return nullptr;
+  }
+  FILE *f = fopen(filename(key).c_str(), "rb");
+  if (!f) {
+    return nullptr;
+  }
+  std::shared_ptr<Frames> frames;
+  char magic[sizeof(RENDER_FILE_MAGIC) - 1];
+  std::string fileKey(key.length(), '\0');
+  uint32_t numFrames = 0;
+  if (fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+      memcmp(magic, RENDER_FILE_MAGIC, sizeof(magic)) == 0 &&
+      fread(&fileKey[0], 1, fileKey.length(), f) == fileKey.length() && fileKey == key &&
+      fread(&numFrames, sizeof(numFrames), 1, f) == 1) {
+    std::vector<uint8_t> bytes(numFrames * 3);
+    if (fread(bytes.data(), 1, bytes.size(), f) == bytes.size()) {
+      frames.reset(new Frames(numFrames));
+      for (uint32_t i = 0; i < numFrames; ++i) {
+        (*frames)[i] = RGBColor(bytes[(i * 3) + 0], bytes[(i * 3) + 1], bytes[(i * 3) + 2]);
+      }
+    }
+  }
+  fclose(f);
+  return frames;
+}
+
+void RenderCache::save(const std::string &key, const Frames &frames)
+{
+  if (m_dir.empty()) {
+    return;
+  }
+  // write to a temporary file then rename it so a reader never sees half a file
+  std::string name = filename(key);
+  std::string tmpName = name + ".tmp";
+  FILE *f = fopen(tmpName.c_str(), "wb");
+  if (!f) {
+    perror("Failed to write render cache");
+    return;
+  }
+  std::vector<uint8_t> bytes(frames.size() * 3);
+  for (size_t i = 0; i < frames.size(); ++i) {
+    bytes[(i * 3) + 0] = frames[i].red;
+    bytes[(i * 3) + 1] = frames[i].green;
+    bytes[(i * 3) + 2] = frames[i].blue;
+  }
+  uint32_t numFrames = (uint32_t)frames.size();
+  bool success = fwrite(RENDER_FILE_MAGIC, 1, sizeof(RENDER_FILE_MAGIC) - 1, f) == sizeof(RENDER_FILE_MAGIC) - 1 &&
+    fwrite(key.data(), 1, key.length(), f) == key.length() &&
+    fwrite(&numFrames, sizeof(numFrames), 1, f) == 1 &&
+    fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  if (fclose(f) != 0 || !success || rename(tmpName.c_str(), name.c_str()) != 0) {
+    perror("Failed to write render cache");
+    remove(tmpName.c_str());
+  }
+}
+
+std::string RenderCache::filename(const std::string &key) const
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < key.length(); ++i) {
+    hash = (hash ^ (uint8_t)key[i]) * FNV_PRIME;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.render", (unsigned long long)hash);
+  return m_dir + "/" + name;
+}
+
+void RenderCache::insert(const std::string &key, std::shared_ptr<const Frames> frames)
+{
+  // another thread may have beaten this one to it
+  std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = m_index.find(key);
+  if (it != m_index.end()) {
+    m_entries.erase(it->second);
+    m_index.erase(it);
+  }
+  m_entries.push_front(Entry(key, frames));
+  m_index[key] = m_entries.begin();
+  while (m_entries.size() > m_maxEntries) {
+    m_index.erase(m_entries.back().first);
+    m_entries.pop_back();
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <inttypes.h>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <list>
+
+#include "Colortypes.h"
+
+class Pattern;
+
+// A least recently used cache of pattern renders.
+//
+// A render is a number of periods of a pattern played on it's own, starting
+// where the pattern begins repeating, with the brightness scale applied.
+// That only depends on the bytes of the pattern that get saved to storage
+// (the args and colorset) so renders are keyed on those bytes plus the render
+// parameters. With a directory every render is also saved to a file named
+// after the hash of the key so later runs can load it instead of simulating.
+// The files don't know which build made them so clear out the directory if
+// the engine changes, make clean does this for the default directory.
+//
+// The cache is safe to share between threads.
+class RenderCache
+{
+public:
+  typedef std::vector<RGBColor> Frames;
+
+  // maxEntries is the number of renders held in memory, an empty dir
+  // keeps the cache in memory only
+  RenderCache(uint32_t maxEntries, const std::string &dir = "");
+
+  // render numCycles periods of a pattern, or fetch it from the cache
+  std::shared_ptr<const Frames> render(const Pattern &pat, float brightnessScale, uint32_t numCycles);
+
+  // renders served from memory, loaded from the directory, or simulated
+  uint64_t hits() const { return m_hits; }
+  uint64_t diskHits() const { return m_diskHits; }
+  uint64_t misses() const { return m_misses; }
+
+private:
+  // simulate a render on the calling thread
+  static std::shared_ptr<const Frames> simulate(const Pattern &pat, float brightnessScale, uint32_t numCycles);
+  // load or save the file of a key, the key is stored in the file
+  // to catch the odd collision of the hash in the file name
+  std::shared_ptr<const Frames> load(const std::string &key);
+  void save(const std::string &key, const Frames &frames);
+  std::string filename(const std::string &key) const;
+
+  // put a render at the front of the list, dropping the oldest if full
+  void insert(const std::string &key, std::shared_ptr<const Frames> frames);
+
+  typedef std::pair<std::string, std::shared_ptr<const Frames> > Entry;
+
+  uint32_t m_maxEntries;
+  std::string m_dir;
+  // most recently used first
+  std::list<Entry> m_entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+  std::mutex m_mutex;
+
+  uint64_t m_hits;
+  uint64_t m_diskHits;
+  uint64_t m_misses;
+};
+
+#endif
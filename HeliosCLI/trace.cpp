@@ -0,0 +1,358 @@
+#include <string.h>
+
+#include <chrono>
+
+#include "HeliosEngine.h"
+#include "TimeControl.h"
+#include "Helios.h"
+#include "Button.h"
+#include "Led.h"
+
+#include "trace.h"
+
+// the first bytes of every trace
+#define TRACE_MAGIC "HTR2"
+
+// the size of the buffer used to stream a trace in or out
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+TraceColors::TraceColors() :
+  m_colors(),
+  m_numColors(0)
+{
+}
+
+int32_t TraceColors::find(RGBColor col) const
+{
+  for (uint32_t i = 0; i < m_numColors; ++i) {
+    if (m_colors[i] == col) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+void TraceColors::use(RGBColor col)
+{
+  int32_t index = find(col);
+  if (index < 0) {
+    // a new color pushes the oldest one out
+    if (m_numColors < TRACE_RECENT_COLORS) {
+      m_numColors++;
+    }
+    index = m_numColors - 1;
+  }
+  for (int32_t i = index; i > 0; --i) {
+    m_colors[i] = m_colors[i - 1];
+  }
+  m_colors[0] = col;
+}
+
+TraceWriter::TraceWriter() :
+  m_file(nullptr),
+  m_buffer(nullptr),
+  m_lastTick(0),
+  m_color(),
+  m_hasColor(false),
+  m_recent()
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+  if (m_file) {
+    fclose(m_file);
+  }
+  delete[] m_buffer;
+}
+
+bool TraceWriter::open(const std::string &filename, const DeviceConfig &config, const uint8_t *storage)
+{
+  m_file = fopen(filename.c_str(), "wb");
+  if (!m_file) {
+    perror("Failed to open trace");
+    return false;
+  }
+  m_buffer = new char[TRACE_BUFFER_SIZE];
+  setvbuf(m_file, m_buffer, _IOFBF, TRACE_BUFFER_SIZE);
+  // every tick in the trace counts from the start of the session
+  m_lastTick = 0;
+  fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC) - 1, m_file);
+  writeVarint(storage ? TRACE_FLAG_STORAGE : 0);
+  writeString(config.colorset);
+  writeString(config.pattern);
+  writeString(config.pattern_args);
+  writeVarint(config.mode_index);
+  writeVarint(config.seek);
+  if (storage) {
+    fwrite(storage, 1, STORAGE_SIZE, m_file);
+  }
+  return !ferror(m_file);
+}
+
+void TraceWriter::input(uint32_t tick, char command)
+{
+  writeRecord(TRACE_INPUT, tick);
+  fputc(command, m_file);
+}
+
+void TraceWriter::color(uint32_t tick, RGBColor col)
+{
+  if (m_hasColor && col == m_color) {
+    return;
+  }
+  int32_t index = m_recent.find(col);
+  if (index >= 0) {
+    writeRecord(TRACE_RECENT_COLOR + index, tick);
+  } else {
+    writeRecord(TRACE_COLOR, tick);
+    fputc(col.red, m_file);
+    fputc(col.green, m_file);
+    fputc(col.blue, m_file);
+  }
+  m_recent.use(col);
+  m_color = col;
+  m_hasColor = true;
+}
+
+bool TraceWriter::close(uint32_t tick)
+{
+  if (!m_file) {
+    return false;
+  }
+  writeRecord(TRACE_END, tick);
+  bool success = !ferror(m_file);
+  if (fclose(m_file) != 0 || !success) {
+    perror("Failed to write trace");
+    success = false;
+  }
+  m_file = nullptr;
+  return success;
+}
+
+void TraceWriter::writeRecord(uint8_t tag, uint32_t tick)
+{
+  fputc(tag, m_file);
+  writeVarint(tick - m_lastTick);
+  m_lastTick = tick;
+}
+
+void TraceWriter::writeVarint(uint32_t val)
+{
+  while (val >= 0x80) {
+    fputc((val & 0x7F) | 0x80, m_file);
+    val >>= 7;
+  }
+  fputc(val, m_file);
+}
+
+void TraceWriter::writeString(const std::string &str)
+{
+  writeVarint((uint32_t)str.length());
+  fwrite(str.data(), 1, str.length(), m_file);
+}
+
+TraceReader::TraceReader() :
+  m_file(nullptr),
+  m_buffer(nullptr),
+  m_lastTick(0),
+  m_recent()
+{
+}
+
+TraceReader::~TraceReader()
+{
+  if (m_file) {
+    fclose(m_file);
+  }
+  delete[] m_buffer;
+}
+
+bool TraceReader::open(const std::string &filename, DeviceConfig &config, bool &storage, uint8_t *storageImage)
+{
+  m_file = fopen(filename.c_str(), "rb");
+  if (!m_file) {
+    perror("Failed to open trace");
+    return false;
+  }
+  m_buffer = new char[TRACE_BUFFER_SIZE];
+  setvbuf(m_file, m_buffer, _IOFBF, TRACE_BUFFER_SIZE);
+  char magic[sizeof(TRACE_MAGIC) - 1];
+  uint32_t flags = 0;
+  if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+      memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || !readVarint(flags) ||
+      !readString(config.colorset) || !readString(config.pattern) ||
+      !readString(config.pattern_args) || !readVarint(config.mode_index) ||
+      !readVarint(config.seek)) {
+    return false;
+  }
+  storage = (flags & TRACE_FLAG_STORAGE) != 0;
+  if (storage && fread(storageImage, 1, STORAGE_SIZE, m_file) != STORAGE_SIZE) {
+    return false;
+  }
+  return true;
+}
+
+bool TraceReader::next(TraceEvent &event)
+{
+  int tag = fgetc(m_file);
+  uint32_t delta = 0;
+  if (tag == EOF || !readVarint(delta)) {
+    return false;
+  }
+  m_lastTick += delta;
+  event.tag = (uint8_t)tag;
+  event.tick = m_lastTick;
+  if (tag == TRACE_END) {
+    return true;
+  }
+  if (tag == TRACE_INPUT) {
+    int command = fgetc(m_file);
+    event.input = (char)command;
+    return command != EOF;
+  }
+  if (tag == TRACE_COLOR) {
+    uint8_t rgb[3];
+    if (fread(rgb, 1, sizeof(rgb), m_file) != sizeof(rgb)) {
+      return false;
+    }
+    event.color = RGBColor(rgb[0], rgb[1], rgb[2]);
+  } else if (tag >= TRACE_RECENT_COLOR && tag < TRACE_RECENT_COLOR + TRACE_RECENT_COLORS) {
+    int32_t index = tag - TRACE_RECENT_COLOR;
+    if (index >= (int32_t)m_recent.size()) {
+      return false;
+    }
+    event.color = m_recent.get(index);
+    event.tag = TRACE_COLOR;
+  } else {
+    return false;
+  }
+  m_recent.use(event.color);
+  return true;
+}
+
+bool TraceReader::readVarint(uint32_t &val)
+{
+  val = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7) {
+    int byte = fgetc(m_file);
+    if (byte == EOF) {
+      return false;
+    }
+    val |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceReader::readString(std::string &str)
+{
+  uint32_t len = 0;
+  if (!readVarint(len)) {
+    return false;
+  }
+  str.resize(len);
+  return !len || fread(&str[0], 1, len, m_file) == len;
+}
+
+int run_replay(const std::string &filename, bool verify)
+{
+  TraceReader reader;
+  DeviceConfig config;
+  bool storage = false;
+  uint8_t storageImage[STORAGE_SIZE] = {0};
+  if (!reader.open(filename, config, storage, storageImage)) {
+    fprintf(stderr, "Failed to read trace header: %s\n", filename.c_str());
+    return 1;
+  }
+  // the session runs on a fresh device with the storage it started with
+  HeliosEngine engine;
+  engine.enableStorage(storage);
+  memcpy(engine.storage(), storageImage, STORAGE_SIZE);
+  engine.bind();
+  Helios::init();
+  apply_device_config(config);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // the engine clock starts over when the device wakes up so keep count
+  uint32_t now = 0;
+  uint64_t numInputs = 0;
+  uint64_t numColors = 0;
+  RGBColor expected;
+  bool hasExpected = false;
+  bool ended = false;
+  bool mismatch = false;
+  TraceEvent event;
+  bool ok = reader.next(event);
+  while (ok) {
+    // queue the input the button processed on this tick
+    if (event.tag == TRACE_INPUT && event.tick == now) {
+      Button::queueInput(event.input);
+      numInputs++;
+      ok = reader.next(event);
+      if (!ok) {
+        break;
+      }
+    }
+    if (event.tag == TRACE_END && event.tick == now) {
+      ended = true;
+      break;
+    }
+    if (event.tick <= now && !(event.tag == TRACE_COLOR && event.tick == now)) {
+      // every record of this tick should have been used up already
+      ok = false;
+      break;
+    }
+    if (!Helios::keep_going()) {
+      if (verify) {
+        printf("Mismatch: the device quit on tick %u but the trace continues\n", now);
+        mismatch = true;
+      }
+      break;
+    }
+    Helios::tick();
+    if (event.tag == TRACE_COLOR && event.tick == now) {
+      expected = event.color;
+      hasExpected = true;
+      numColors++;
+      ok = reader.next(event);
+    }
+    RGBColor col = Led::get();
+    if (verify && (!hasExpected || col != expected)) {
+      printf("Mismatch on tick %u: expected %02X%02X%02X but the led is %02X%02X%02X\n", now,
+          expected.red, expected.green, expected.blue, col.red, col.green, col.blue);
+      mismatch = true;
+      break;
+    }
+    if (!ok) {
+      break;
+    }
+    now++;
+    // nothing changes until the next event of either the device or the trace
+    uint32_t cur = Time::getCurtime();
+    uint32_t next = Helios::next_event_tick();
+    if (next == UINT32_MAX || next - cur > event.tick - now) {
+      next = cur + (event.tick - now);
+    }
+    Helios::skip_to(next);
+    now += next - cur;
+  }
+  uint32_t numTicks = now;
+  engine.unbind();
+  double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (!ok && !mismatch) {
+    fprintf(stderr, "Trace is cut short or corrupt after tick %u: %s\n", numTicks, filename.c_str());
+    return 1;
+  }
+  printf("Replayed %u ticks, %llu inputs and %llu color changes in %.3fms (%.0f ticks/sec)\n",
+      numTicks, (unsigned long long)numInputs, (unsigned long long)numColors, elapsed_ms,
+      numTicks * 1000.0 / (elapsed_ms ? elapsed_ms : 1));
+  if (mismatch) {
+    return 1;
+  }
+  if (verify && ended) {
+    printf("Verified: the led output matches the trace\n");
+  }
+  return 0;
+}
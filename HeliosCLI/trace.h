@@ -0,0 +1,143 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+
+#include "Colortypes.h"
+#include "device_config.h"
+
+// A binary trace of a device session: the setup of the device, every input
+// the button processed and every change of the led color, each stamped with
+// the tick it happened on counting from the start of the session.
+//
+// The file starts with the magic "HTR2" and a header:
+//
+//   varint flags               TRACE_FLAG_STORAGE if storage was enabled
+//   string colorset            each string is a varint length then the bytes
+//   string pattern
+//   string pattern-args
+//   varint mode index
+//   varint seek
+//   STORAGE_SIZE bytes         the storage image at the start, only with storage
+//
+// Then a stream of records, each a tag byte followed by a varint of the ticks
+// since the previous record and whatever the tag carries:
+//
+//   TRACE_END                  the session stopped on this tick
+//   TRACE_INPUT + 1 byte       the input command processed on this tick
+//   TRACE_COLOR + 3 bytes      the led changed to this r/g/b on this tick
+//   TRACE_RECENT_COLOR + n     the led changed to the nth most recent color
+//
+// The led only gets a record when it changes so a color held for an hour is
+// still one record, and patterns flip between a handful of colors so most
+// changes are a single recent color byte plus a one byte delta. Waits are
+// never recorded, they are just the gaps between records. The colors are the
+// raw led colors before any brightness scale.
+//
+// Varints are unsigned LEB128, 7 bits per byte with the high bit set on every
+// byte but the last.
+enum TraceTag : uint8_t
+{
+  TRACE_END = 0,
+  TRACE_INPUT = 1,
+  TRACE_COLOR = 2,
+  // TRACE_RECENT_COLOR + the index into the recent colors
+  TRACE_RECENT_COLOR = 8,
+};
+
+// the number of recently used colors a record can refer back to
+#define TRACE_RECENT_COLORS 8
+
+#define TRACE_FLAG_STORAGE (1 << 0)
+
+// the colors most recently written to a trace, most recent first, the
+// writer and reader both keep one so they always agree on the indexes
+class TraceColors
+{
+public:
+  TraceColors();
+
+  // the index of a color or -1 if it isn't one of the recent colors
+  int32_t find(RGBColor col) const;
+  RGBColor get(uint32_t index) const { return m_colors[index]; }
+  uint32_t size() const { return m_numColors; }
+  // move a color to the front, pushing out the oldest if it's new
+  void use(RGBColor col);
+
+private:
+  RGBColor m_colors[TRACE_RECENT_COLORS];
+  uint32_t m_numColors;
+};
+
+// writes a trace to a file as the session runs
+class TraceWriter
+{
+public:
+  TraceWriter();
+  ~TraceWriter();
+
+  // start a trace of a device with the given setup, the storage image is
+  // null if storage is disabled
+  bool open(const std::string &filename, const DeviceConfig &config, const uint8_t *storage);
+  // record an input processed on a tick, or the led color shown from a tick
+  // onwards which is only written if it changed
+  void input(uint32_t tick, char command);
+  void color(uint32_t tick, RGBColor col);
+  // record the tick the session stopped on and close the file
+  bool close(uint32_t tick);
+
+private:
+  void writeRecord(uint8_t tag, uint32_t tick);
+  void writeVarint(uint32_t val);
+  void writeString(const std::string &str);
+
+  FILE *m_file;
+  char *m_buffer;
+  uint32_t m_lastTick;
+  RGBColor m_color;
+  bool m_hasColor;
+  TraceColors m_recent;
+};
+
+// a single record read back out of a trace
+struct TraceEvent
+{
+  uint8_t tag;
+  uint32_t tick;
+  char input;
+  RGBColor color;
+};
+
+// streams the records of a trace back out of a file
+class TraceReader
+{
+public:
+  TraceReader();
+  ~TraceReader();
+
+  // open a trace and read the header, the storage image must have room for
+  // STORAGE_SIZE bytes and is only filled if storage was enabled
+  bool open(const std::string &filename, DeviceConfig &config, bool &storage, uint8_t *storageImage);
+  // read the next record, returns false at the end of the file or if the
+  // file is cut short or corrupt, the TRACE_END record is the last one
+  bool next(TraceEvent &event);
+
+private:
+  bool readVarint(uint32_t &val);
+  bool readString(std::string &str);
+
+  FILE *m_file;
+  char *m_buffer;
+  uint32_t m_lastTick;
+  TraceColors m_recent;
+};
+
+// replay a trace on a fresh device and print how fast it ran, with verify
+// the led output is checked against the trace and the first difference is
+// reported. Returns the process exit code, non-zero if the trace can't be
+// read or doesn't match
+int run_replay(const std::string &filename, bool verify);
+
+#endif
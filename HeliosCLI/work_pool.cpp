@@ -0,0 +1,123 @@
+#include "work_pool.h"
+
+WorkPool::WorkPool(uint32_t numWorkers, uint32_t maxPending) :
+  m_workers(),
+  m_queues(),
+  m_nextQueue(0),
+  m_maxPending(maxPending),
+  m_mutex(),
+  m_taskReady(),
+  m_taskDone(),
+  m_queued(0),
+  m_unfinished(0),
+  m_stop(false)
+{
+  if (!numWorkers) {
+    numWorkers = std::thread::hardware_concurrency();
+  }
+  if (!numWorkers) {
+    numWorkers = 1;
+  }
+  // all of the queues must exist before any worker tries to steal
+  for (uint32_t i = 0; i < numWorkers; ++i) {
+    m_queues.push_back(new WorkQueue());
+  }
+  for (uint32_t i = 0; i < numWorkers; ++i) {
+    m_workers.push_back(std::thread(&WorkPool::workerMain, this, i));
+  }
+}
+
+WorkPool::~WorkPool()
+{
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_taskReady.notify_all();
+  for (uint32_t i = 0; i < m_workers.size(); ++i) {
+    m_workers[i].join();
+  }
+  for (uint32_t i = 0; i < m_queues.size(); ++i) {
+    delete m_queues[i];
+  }
+}
+
+void WorkPool::submit(Task task)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // apply backpressure so the caller can't queue up unbounded work
+    while (m_maxPending && m_unfinished >= m_maxPending) {
+      m_taskDone.wait(lock);
+    }
+    m_unfinished++;
+    // push the task and count it in one step so a worker can never
+    // pop the task before it has been counted
+    WorkQueue *queue = m_queues[m_nextQueue];
+    m_nextQueue = (m_nextQueue + 1) % m_queues.size();
+    std::lock_guard<std::mutex> queueLock(queue->mutex);
+    queue->tasks.push_back(task);
+    m_queued++;
+  }
+  m_taskReady.notify_one();
+}
+
+void WorkPool::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (m_unfinished > 0) {
+    m_taskDone.wait(lock);
+  }
+}
+
+bool WorkPool::popTask(uint32_t worker, Task &task)
+{
+  uint32_t numQueues = (uint32_t)m_queues.size();
+  // the back of our own queue first, then steal from the front of the others
+  for (uint32_t i = 0; i < numQueues; ++i) {
+    WorkQueue *queue = m_queues[(worker + i) % numQueues];
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      task = queue->tasks.back();
+      queue->tasks.pop_back();
+    } else {
+      task = queue->tasks.front();
+      queue->tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void WorkPool::workerMain(uint32_t worker)
+{
+  while (1) {
+    Task task;
+    if (!popTask(worker, task)) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      // the task counter is only ever touched under the lock so a task
+      // that gets queued after the pop above can't be slept through
+      while (!m_queued && !m_stop) {
+        m_taskReady.wait(lock);
+      }
+      if (m_stop && !m_queued) {
+        return;
+      }
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queued--;
+    }
+    task(worker);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_unfinished--;
+    }
+    m_taskDone.notify_all();
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include <inttypes.h>
+
+// A work-stealing thread pool, each worker has it's own queue of tasks which
+// it pops from the back of, and when it runs out it steals from the front of
+// the other workers queues. Tasks are handed out round-robin as they are
+// submitted so most of the time workers never touch each others queues.
+class WorkPool
+{
+public:
+  // a task is given the index of the worker that runs it
+  typedef std::function<void(uint32_t worker)> Task;
+
+  // numWorkers 0 means one worker per core, maxPending 0 means submit never
+  // blocks, otherwise submit blocks while that many tasks are unfinished
+  WorkPool(uint32_t numWorkers = 0, uint32_t maxPending = 0);
+  ~WorkPool();
+
+  // queue up a task for the workers
+  void submit(Task task);
+  // block until every submitted task has finished
+  void wait();
+
+  uint32_t numWorkers() const { return (uint32_t)m_workers.size(); }
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void workerMain(uint32_t worker);
+  bool popTask(uint32_t worker, Task &task);
+
+  std::vector<std::thread> m_workers;
+  std::vector<WorkQueue *> m_queues;
+  // the next queue to hand a submitted task to
+  uint32_t m_nextQueue;
+  // the limit of unfinished tasks before submit blocks
+  uint32_t m_maxPending;
+
+  // guards the counters below and the condition variables
+  std::mutex m_mutex;
+  // signalled when a task is queued or the pool stops
+  std::condition_variable m_taskReady;
+  // signalled when a task finishes
+  std::condition_variable m_taskDone;
+  // tasks sitting in the queues
+  uint32_t m_queued;
+  // tasks that are queued or running
+  uint32_t m_unfinished;
+  bool m_stop;
+};
+
+#endif
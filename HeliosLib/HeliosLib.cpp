@@ -2,8 +2,12 @@
 
 // Helios includes
 #include "Helios.h"
+#include "HeliosEngine.h"
+#include "TimeControl.h"
 #include "Led.h"
 
+#include <vector>
+
 #ifdef WASM
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
@@ -27,6 +31,40 @@ val tick_helios() {
   return color;
 }
 
+// render a number of ticks into a Uint8Array of red, green, blue triplets
+val render_helios(uint32_t numTicks)
+{
+  std::vector<RGBColor> colors(numTicks);
+  uint32_t ticks = HeliosLib::render(colors.data(), numTicks);
+  std::vector<uint8_t> bytes(ticks * 3);
+  for (uint32_t i = 0; i < ticks; ++i) {
+    bytes[(i * 3) + 0] = colors[i].red;
+    bytes[(i * 3) + 1] = colors[i].green;
+    bytes[(i * 3) + 2] = colors[i].blue;
+  }
+  // the memory view is only valid until this returns so copy it into js
+  return val::global("Uint8Array").new_(typed_memory_view(bytes.size(), bytes.data()));
+}
+
+// render a number of ticks into a Uint32Array of raw color, duration pairs
+val render_runs_helios(uint32_t numTicks)
+{
+  std::vector<LedRun> runs(numTicks);
+  uint32_t numRuns = HeliosLib::renderRuns(runs.data(), numTicks, numTicks);
+  std::vector<uint32_t> pairs(numRuns * 2);
+  for (uint32_t i = 0; i < numRuns; ++i) {
+    pairs[(i * 2) + 0] = runs[i].color.raw();
+    pairs[(i * 2) + 1] = runs[i].duration;
+  }
+  return val::global("Uint32Array").new_(typed_memory_view(pairs.size(), pairs.data()));
+}
+
+// queue a string of input commands into a simulated device
+static void engine_queue_inputs(HeliosEngine &engine, std::string inputs)
+{
+  engine.queueInputs(inputs.c_str());
+}
+
 // js is dumb and has issues doing this cast I guess
 PatternID intToPatternID(int val)
 {
@@ -38,6 +76,21 @@ EMSCRIPTEN_BINDINGS(Vortex) {
   function("Init", &init_helios);
   function("Cleanup", &cleanup_helios);
   function("Tick", &tick_helios);
+  function("Render", &render_helios);
+  function("RenderRuns", &render_runs_helios);
+
+  // independent simulated devices
+  class_<HeliosEngine>("HeliosEngine")
+    .constructor<>()
+    .function("init", &HeliosEngine::init)
+    .function("tick", &HeliosEngine::tick)
+    .function("run", &HeliosEngine::run)
+    .function("queueInputs", &engine_queue_inputs)
+    .function("enableStorage", &HeliosEngine::enableStorage)
+    .function("keepGoing", &HeliosEngine::keepGoing)
+    .function("isAsleep", &HeliosEngine::isAsleep)
+    .function("curTick", &HeliosEngine::curTick)
+    .function("ledColor", &HeliosEngine::ledColor);
 
   // Bind the HSVColor class
   class_<HSVColor>("HSVColor")
@@ -131,6 +184,9 @@ EMSCRIPTEN_BINDINGS(Vortex) {
   // pattern class
   class_<Pattern>("Pattern")
     .function("init", &Pattern::init)
+    .function("seek", &Pattern::seek)
+    .function("period", &Pattern::period)
+    .function("periodStart", &Pattern::periodStart)
     .function("setArgs", &Pattern::setArgs)
     .function("getArgs", select_overload<PatternArgs()>(&Pattern::getArgs))
     .function("equals", &Pattern::equals, allow_raw_pointer<const Pattern *>())
@@ -164,3 +220,56 @@ void HeliosLib::tick()
 {
   Helios::tick();
 }
+
+uint32_t HeliosLib::render(RGBColor *out, uint32_t numTicks)
+{
+  uint32_t ticks = 0;
+  while (ticks < numTicks && Helios::keep_going()) {
+    uint32_t duration = nextRun(numTicks - ticks);
+    RGBColor col = Led::get();
+    for (uint32_t i = 0; i < duration; ++i) {
+      out[ticks++] = col;
+    }
+  }
+  return ticks;
+}
+
+uint32_t HeliosLib::renderRuns(LedRun *out, uint32_t maxRuns, uint32_t numTicks)
+{
+  uint32_t numRuns = 0;
+  uint32_t ticks = 0;
+  while (ticks < numTicks && Helios::keep_going()) {
+    // the next tick might start a new run and there's no room for it
+    if (numRuns == maxRuns) {
+      break;
+    }
+    uint32_t duration = nextRun(numTicks - ticks);
+    RGBColor col = Led::get();
+    ticks += duration;
+    // the color might not have changed even though something did
+    if (numRuns > 0 && out[numRuns - 1].color == col) {
+      out[numRuns - 1].duration += duration;
+      continue;
+    }
+    out[numRuns].color = col;
+    out[numRuns].duration = duration;
+    numRuns++;
+  }
+  return numRuns;
+}
+
+uint32_t HeliosLib::nextRun(uint32_t maxTicks)
+{
+  Helios::tick();
+  if (!Helios::keep_going()) {
+    return 1;
+  }
+  // every tick up to the next event shows the same color as this one
+  uint32_t now = Time::getCurtime();
+  uint32_t next = Helios::next_event_tick();
+  if (next == UINT32_MAX || next - now >= maxTicks) {
+    next = now + maxTicks - 1;
+  }
+  Helios::skip_to(next);
+  return 1 + (next - now);
+}
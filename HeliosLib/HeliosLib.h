@@ -4,6 +4,17 @@
 // HeliosCLI would wrap this library to produce a CLI tool, but we already
 // wrapped the Helios core so we should abstract some of that logic to here and
 // simplify the CLI tool by just using this library directly
+#include <inttypes.h>
+
+#include "Colortypes.h"
+
+// a color that the led holds for a number of ticks
+struct LedRun
+{
+    RGBColor color;
+    uint32_t duration;
+};
+
 class HeliosLib
 {
 public:
@@ -11,5 +22,20 @@ public:
     static void cleanup();
 
     static void tick();
+
+    // run numTicks ticks and fill the buffer with the led color of each tick,
+    // this jumps straight over any ticks where nothing can change so the input
+    // for those ticks must already be queued. Stops early if the device quits,
+    // returns the number of ticks written
+    static uint32_t render(RGBColor *out, uint32_t numTicks);
+    // the same as render but each run of identical ticks is written as a
+    // single color and duration, stops early if the device quits or maxRuns
+    // runs were written, returns the number of runs written
+    static uint32_t renderRuns(LedRun *out, uint32_t maxRuns, uint32_t numTicks);
+
+private:
+    // run the next tick then skip ahead over the ticks that will show the
+    // same color, returns how many ticks the color is held up to maxTicks
+    static uint32_t nextRun(uint32_t maxTicks);
 };
 
@@ -44,7 +44,7 @@ echo "--------------------------------------------------------------------------
 rm -f Helios.storage
 
 # strip any \r in case this was run on windows
-$HELIOS $ARGS --no-timestep --hex <<< $INPUT >> $TEMP_FILE
+$HELIOS $ARGS --no-timestep --hex --rle <<< $INPUT >> $TEMP_FILE
 
 sed -i 's/\r//g' $TEMP_FILE
 # Replace the original file with the modified temp file
@@ -9,6 +9,10 @@ TARGETREPO=
 VERBOSE=0
 AUDIT=0
 NOMAKE=0
+FARM=0
+TICKLESS=0
+MODES=0
+TIMELINE=
 TODO=
 
 for arg in "$@"
@@ -20,6 +24,18 @@ do
   if [ "$arg" == "-n" ]; then
     NOMAKE=1
   fi
+  if [ "$arg" == "-p" ]; then
+    FARM=1
+  fi
+  if [ "$arg" == "-k" ]; then
+    TICKLESS=1
+  fi
+  if [ "$arg" == "-m" ]; then
+    MODES=1
+  fi
+  if [ "$arg" == "-l" ]; then
+    TIMELINE="--timeline"
+  fi
   if [ "$arg" == "-f" ]; then
     VALGRIND="valgrind --quiet --leak-check=full --show-leak-kinds=all"
   fi
@@ -35,6 +51,9 @@ done
 
 function run_tests() {
   PROJECT="tests"
+  if [ $MODES -eq 1 ]; then
+    PROJECT="modes"
+  fi
 
   ALLSUCCES=1
 
@@ -72,10 +91,29 @@ function run_tests() {
 
   TESTCOUNT=0
 
+  # run every test at once on the device farm, the outputs are diffed below
+  if [ $FARM -eq 1 ] && [ $MODES -eq 0 ]; then
+    JOBS="tmp/$PROJECT/jobs.txt"
+    for FILE in $FILES; do
+      INPUT="$(grep "Input=" $FILE | cut -d= -f2 | tr -d '\n' | tr -d '\r')"
+      ARGS="$(grep "Args=" $FILE | cut -d= -f2- | tr -d '\n' | tr -d '\r')"
+      STORAGE=0
+      if [ "$ARGS" == "--storage" ]; then
+        STORAGE=1
+      elif [ "$ARGS" != "" ]; then
+        echo -e "\e[31mCannot run test $FILE on the farm, unsupported args: $ARGS\e[0m"
+        exit 1
+      fi
+      echo "name=$FILE storage=$STORAGE input=$INPUT output=tmp/${FILE}.output" >> $JOBS
+    done
+    $HELIOS --farm $JOBS $TIMELINE &> tmp/$PROJECT/farm.log
+    tail -n 1 tmp/$PROJECT/farm.log
+  fi
+
   for FILE in $FILES; do
     INPUT="$(grep "Input=" $FILE | cut -d= -f2 | tr -d '\n' | tr -d '\r')"
     BRIEF="$(grep "Brief=" $FILE | cut -d= -f2 | tr -d '\n' | tr -d '\r')"
-    ARGS="$(grep "Args=" $FILE | cut -d= -f2 | tr -d '\n' | tr -d '\r')"
+    ARGS="$(grep "Args=" $FILE | cut -d= -f2- | tr -d '\n' | tr -d '\r')"
     TESTNUM="$(echo $FILE | cut -d/ -f2 | cut -d_ -f1 | cut -d/ -f2)"
     TESTNUM=$((10#$TESTNUM))
     TESTCOUNT=$((TESTCOUNT + 1))
@@ -104,14 +142,26 @@ function run_tests() {
       echo "Test: $TESTNUM"
       echo "-----------------------------"
     fi
-    # ensure there is no leftover storage file
-    rm -f Helios.storage
-    # now run the test
-    $VALGRIND $HELIOS $ARGS --no-timestep --hex <<< $INPUT &> $OUTPUT
+    if [ $MODES -eq 1 ]; then
+      rm -f Helios.storage
+      # mode tests give the whole command line and can chain several runs
+      # of \$HELIOS that share files in tmp/modes
+      eval "$VALGRIND $HELIOS $ARGS" <<< $INPUT &> $OUTPUT
+    elif [ $FARM -eq 0 ]; then
+      # ensure there is no leftover storage file
+      rm -f Helios.storage
+      # now run the test
+      if [ $TICKLESS -eq 1 ]; then
+        # tickless output is already made of runs
+        $VALGRIND $HELIOS $ARGS $TIMELINE --tickless --hex <<< $INPUT &> $OUTPUT
+      else
+        $VALGRIND $HELIOS $ARGS $TIMELINE --no-timestep --hex --rle <<< $INPUT &> $OUTPUT
+      fi
+    fi
     # and diff the result
     $DIFF --brief $EXPECTED $OUTPUT &> $DIFFOUT
     RESULT=$?
-    if [ $VERBOSE -eq 1 ]; then
+    if [ $VERBOSE -eq 1 ] && [ $MODES -eq 0 ]; then
       $HELIOS $ARGS --no-timestep --color <<< $INPUT
     fi
     if [ $RESULT -eq 0 ]; then